@@ -0,0 +1,32 @@
+/*
+ * Converts a chemoattractant snapshot archive (src/snapshot_archive.h) back to one csv file per snapshot, as a run with
+ * chemo_format csv writes them, e.g.
+ *
+ *     ./archive_to_csv ChemoConc.nca [output_prefix]
+ */
+
+
+#include "snapshot_archive.h"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        cerr << "usage: " << argv[0] << " archive [output_prefix]" << endl;
+        return 2;
+    }
+
+    try {
+        const int n = archive_to_csv(argv[1], argc > 2 ? argv[2] : "");
+        cout << "wrote " << n << " snapshots" << endl;
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
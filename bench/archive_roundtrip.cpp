@@ -0,0 +1,176 @@
+/*
+ * Checks the chemoattractant archive format (src/snapshot_archive.h) with every encoding: snapshots read back as they
+ * were appended (to within the quantisation with quantise16), a restart drops the later snapshots, a damaged index is
+ * rebuilt and a snapshot cut short by a crash is dropped.
+ *
+ * usage: archive_roundtrip [directory for the files]
+ */
+
+#include "snapshot_archive.h"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+
+struct snapshot {
+    double t;
+    int step;
+    VectorXd x;
+    MatrixXd u;
+};
+
+
+// a grown grid and a field that is smooth with noise on top, as the model's
+static snapshot make_snapshot(int k, int nx, int ny, default_random_engine &gen) {
+    uniform_real_distribution<double> noise(-1e-3, 1e-3);
+    snapshot s;
+    s.t = 0.5 * k;
+    s.step = 50 * k;
+    s.x.resize(nx);
+    s.u.resize(nx, ny);
+    for (int i = 0; i < nx; ++i) {
+        s.x(i) = i * (1 + 0.01 * k) + 0.001 * i * i;
+        for (int j = 0; j < ny; ++j) {
+            s.u(i, j) = 0.5 + 0.4 * sin(0.05 * i + 0.1 * k) * cos(0.07 * j) + noise(gen);
+        }
+    }
+    return s;
+}
+
+
+// whether snapshot k of the archive is s, exactly or to within the 16 bit quantisation
+static bool same(const SnapshotArchive &archive, int k, const snapshot &s, bool quantised) {
+    VectorXd x;
+    MatrixXd u;
+    archive.read(k, x, u);
+    if (archive.time(k) != s.t || archive.step(k) != s.step || x != s.x || u.rows() != s.u.rows() ||
+        u.cols() != s.u.cols()) {
+        return false;
+    }
+    if (!quantised) {
+        return u == s.u;
+    }
+    const double range = s.u.maxCoeff() - s.u.minCoeff();
+    return (u - s.u).cwiseAbs().maxCoeff() <= range / 131070 * (1 + 1e-9);
+}
+
+
+static void check_encoding(const string &directory, const string &name, const ArchiveOptions &options) {
+    const string path = directory + "/" + name + ".nca";
+    remove(path.c_str());
+
+    const int nx = 57, ny = 23;
+    default_random_engine gen(1);
+    VectorXd y(ny);
+    for (int j = 0; j < ny; ++j) {
+        y(j) = 0.5 * j;
+    }
+
+    vector<snapshot> snapshots;
+    for (int k = 0; k < 4; ++k) {
+        snapshots.push_back(make_snapshot(k, nx, ny, gen));
+        append_snapshot(path, options, snapshots[k].t, snapshots[k].step, snapshots[k].x, y, snapshots[k].u);
+    }
+
+    {
+        SnapshotArchive archive(path);
+        check(archive.size() == 4 && archive.length_x() == nx && archive.length_y() == ny && archive.y() == y,
+              name + ": index and grid");
+        for (int k = 0; k < min(archive.size(), 4); ++k) {
+            check(same(archive, k, snapshots[k], options.quantise16), name + ": snapshot " + to_string(k));
+        }
+        check(archive.find(1.2) == 2, name + ": find");
+    }
+
+    // a crash while the index is written, then one within the last snapshot
+    const off_t size = [&]() {
+        FILE *f = fopen(path.c_str(), "rb");
+        fseek(f, 0, SEEK_END);
+        const long n = ftell(f);
+        fclose(f);
+        return off_t(n);
+    }();
+    check(truncate(path.c_str(), size - 3) == 0, name + ": truncate");
+    {
+        SnapshotArchive archive(path);
+        check(archive.size() == 4, name + ": with a damaged index " + to_string(archive.size()) + " snapshots, not 4");
+        for (int k = 0; k < min(archive.size(), 4); ++k) {
+            check(same(archive, k, snapshots[k], options.quantise16), name + ": damaged index, snapshot " +
+                                                                       to_string(k));
+        }
+    }
+    check(truncate(path.c_str(), size - 200) == 0, name + ": truncate");
+    {
+        SnapshotArchive archive(path);
+        check(archive.size() == 3, name + ": with a snapshot cut short " + to_string(archive.size()) +
+                                   " snapshots, not 3");
+        for (int k = 0; k < min(archive.size(), 3); ++k) {
+            check(same(archive, k, snapshots[k], options.quantise16), name + ": cut short, snapshot " +
+                                                                       to_string(k));
+        }
+    }
+
+    // appending carries on after the last complete one
+    append_snapshot(path, options, snapshots[3].t, snapshots[3].step, snapshots[3].x, y, snapshots[3].u);
+    {
+        SnapshotArchive archive(path);
+        check(archive.size() == 4 && same(archive, 3, snapshots[3], options.quantise16),
+              name + ": appending after a crash");
+    }
+
+    // a restart from step 100 replaces the snapshots from there on
+    snapshots.resize(2);
+    snapshots.push_back(make_snapshot(7, nx, ny, gen));
+    snapshots.back().step = 100;
+    append_snapshot(path, options, snapshots[2].t, snapshots[2].step, snapshots[2].x, y, snapshots[2].u);
+    {
+        SnapshotArchive archive(path);
+        check(archive.size() == 3, name + ": a restart keeps " + to_string(archive.size()) + " snapshots, not 3");
+        for (int k = 0; k < min(archive.size(), 3); ++k) {
+            check(same(archive, k, snapshots[k], options.quantise16), name + ": after a restart, snapshot " +
+                                                                       to_string(k));
+        }
+    }
+
+    remove(path.c_str());
+}
+
+
+int main(int argc, char **argv) {
+    const string directory = argc > 1 ? argv[1] : ".";
+
+    ArchiveOptions plain, compressed, quantised;
+    compressed.compress = true;
+    quantised.compress = true;
+    quantised.quantise16 = true;
+
+    try {
+        check_encoding(directory, "archive_roundtrip", plain);
+        check_encoding(directory, "archive_roundtrip_z", compressed);
+        check_encoding(directory, "archive_roundtrip_q16", quantised);
+    } catch (const exception &e) {
+        check(false, e.what());
+    }
+
+    cout << "archive: " << (failures == 0 ? "round trip ok" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+/*
+ * Counts hardware cache misses of the calling thread with perf_event_open, for the benchmarks.
+ *
+ * If the counters cannot be opened (not Linux, no PMU in a VM, perf_event_paranoid too strict) available() is false
+ * and the counts are reported as -1.
+ */
+
+#ifndef NC_CACHE_COUNTER_H
+#define NC_CACHE_COUNTER_H
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+
+class CacheCounter {
+public:
+
+    CacheCounter() {
+#ifdef __linux__
+        // last level misses, and L1 data read misses
+        llc_fd_ = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        l1d_fd_ = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+    }
+
+    ~CacheCounter() {
+#ifdef __linux__
+        if (llc_fd_ >= 0) close(llc_fd_);
+        if (l1d_fd_ >= 0) close(l1d_fd_);
+#endif
+    }
+
+    CacheCounter(const CacheCounter &) = delete;
+
+    CacheCounter &operator=(const CacheCounter &) = delete;
+
+    bool available() const { return llc_fd_ >= 0; }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : {llc_fd_, l1d_fd_}) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        for (int fd : {llc_fd_, l1d_fd_}) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    long long llc_misses() const { return read(llc_fd_); }
+
+    long long l1d_misses() const { return read(l1d_fd_); }
+
+private:
+
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+    static long long read(int fd) {
+        long long count = -1;
+#ifdef __linux__
+        if (fd < 0 || ::read(fd, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+#endif
+        return count;
+    }
+
+    int llc_fd_ = -1;
+    int l1d_fd_ = -1;
+};
+
+#endif //NC_CACHE_COUNTER_H
@@ -0,0 +1,93 @@
+/*
+ * Checks the checkpoint format (Simulation::write_checkpoint, src/binary_io.h): a simulation read back from a
+ * checkpoint writes the same bytes again and carries on bitwise as the one written, and a truncated checkpoint or one
+ * of other model parameters is refused.
+ *
+ * usage: checkpoint_roundtrip [final time]
+ */
+
+#include "simulation.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+
+static string checkpoint_of(const Simulation &simulation) {
+    ostringstream out(ios::binary);
+    simulation.write_checkpoint(out);
+    return out.str();
+}
+
+
+// whether reading bytes into a simulation of config throws
+static bool refused(const SimulationConfig &config, const string &bytes) {
+    Simulation simulation(config, 1);
+    istringstream in(bytes, ios::binary);
+    try {
+        simulation.read_checkpoint(in);
+    } catch (const runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+
+int main(int argc, char **argv) {
+    SimulationConfig config;
+    config.final_time = argc > 1 ? atof(argv[1]) : 3;
+    config.save_freq = 0;
+
+    Simulation written(config, 7);
+    while (written.time() < config.final_time / 2) {
+        written.step();
+    }
+    const string bytes = checkpoint_of(written);
+
+    // another seed, everything comes from the checkpoint
+    Simulation read(config, 99);
+    {
+        istringstream in(bytes, ios::binary);
+        read.read_checkpoint(in);
+    }
+    check(checkpoint_of(read) == bytes, "the checkpoint read back is written with other bytes");
+
+    written.run();
+    read.run();
+    check(read.step_count() == written.step_count() && read.time() == written.time(), "time and step");
+    check(read.chemo_field() == written.chemo_field(), "chemoattractant");
+    check(read.gamma() == written.gamma(), "Gamma");
+    check(read.density_profile() == written.density_profile(), "density profile");
+    check(read.break_proportion() == written.break_proportion(), "break proportion");
+    check(read.cells().size() == written.cells().size(), "number of cells");
+    for (size_t i = 0; i < min(read.cells().size(), written.cells().size()); ++i) {
+        if (read.cells().position(i) != written.cells().position(i) || read.cells().id(i) != written.cells().id(i)) {
+            check(false, "cell " + to_string(i));
+            break;
+        }
+    }
+
+    check(refused(config, bytes.substr(0, bytes.size() / 2)), "a truncated checkpoint is read");
+    check(refused(config, bytes.substr(0, bytes.size() - 1)), "a checkpoint one byte short is read");
+    SimulationConfig other = config;
+    other.D *= 2;
+    check(refused(other, bytes), "a checkpoint of another D is read");
+
+    cout << "checkpoint of " << bytes.size() << " bytes at t = " << config.final_time / 2 << ": "
+         << (failures == 0 ? "round trip ok" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
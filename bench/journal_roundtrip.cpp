@@ -0,0 +1,91 @@
+/*
+ * Checks the sweep journal (src/sweep_journal.h): jobs appended are read back by the next run, a NaN break proportion
+ * (no follower entered) included, a line cut short by a crash is dropped, and a journal of another identity is moved
+ * aside.
+ *
+ * usage: journal_roundtrip [directory for the journal]
+ */
+
+#include "sweep_journal.h"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+
+static bool same(const JournalEntry &a, const JournalEntry &b) {
+    const bool same_break = std::isnan(a.break_proportion) ? std::isnan(b.break_proportion) :
+                            a.break_proportion == b.break_proportion;
+    return a.parameter == b.parameter && a.seed == b.seed && same_break && a.density == b.density;
+}
+
+
+static void check_entries(const string &path, const vector<JournalEntry> &entries, const string &what) {
+    SweepJournal journal(path, "grid 1");
+    check(!journal.discarded_stale(), what + ": moved aside");
+    check(journal.entries().size() == entries.size(), what + ": " + to_string(journal.entries().size()) +
+                                                      " jobs, not " + to_string(entries.size()));
+    for (size_t k = 0; k < min(entries.size(), journal.entries().size()); ++k) {
+        check(same(journal.entries()[k], entries[k]), what + ": job " + to_string(k));
+    }
+}
+
+
+int main(int argc, char **argv) {
+    const string path = string(argc > 1 ? argv[1] : ".") + "/journal_roundtrip";
+    remove(path.c_str());
+    remove((path + ".stale").c_str());
+
+    try {
+        vector<JournalEntry> entries(3);
+        entries[0] = {0, 0, 0.25, VectorXi::LinSpaced(8, 0, 7)};
+        entries[1] = {0, 1, 0.0 / 0.0, VectorXi::Zero(8)}; // as break_proportion() without followers
+        entries[2] = {1, 0, 1.0 / 3, VectorXi::Constant(8, 4)};
+        {
+            SweepJournal journal(path, "grid 1");
+            for (const JournalEntry &e : entries) {
+                journal.append(e.parameter, e.seed, e.break_proportion, e.density);
+            }
+        }
+        check_entries(path, entries, "appended");
+
+        // a crash while the last line was written
+        FILE *f = fopen(path.c_str(), "r+");
+        fseek(f, 0, SEEK_END);
+        const long size = ftell(f);
+        fclose(f);
+        check(truncate(path.c_str(), size - 5) == 0, "truncate");
+        entries.pop_back();
+        check_entries(path, entries, "with a line cut short");
+
+        {
+            SweepJournal journal(path, "grid 2");
+            check(journal.discarded_stale() && journal.entries().empty(), "a journal of another grid is used");
+        }
+    } catch (const exception &e) {
+        check(false, e.what());
+    }
+    remove(path.c_str());
+    remove((path + ".stale").c_str());
+
+    cout << "sweep journal: " << (failures == 0 ? "round trip ok" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * Times K seeds of the model stepped one after another as independent simulations against the same seeds advanced in
+ * lockstep (src/lockstep_ensemble.h), and checks that both give bitwise the same density profiles and chemoattractant.
+ *
+ * usage: lockstep_benchmark [number of seeds] [final time]
+ *
+ * In a Release build on one core the ratio was 0.97 to 1.02 for 3 seeds to t = 2 and 4 seeds to t = 20: the
+ * internalisation, a sum over the cells of each seed at every grid point, dominates and is not shared between seeds.
+ * Builds without optimisation show large ratios that only measure the unoptimised code, so the build type is printed.
+ */
+
+#include "lockstep_ensemble.h"
+#include "simulation.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef NC_BUILD_TYPE
+#define NC_BUILD_TYPE "unknown"
+#endif
+
+using namespace std;
+
+
+int main(int argc, char **argv) {
+    const int n_seeds = argc > 1 ? atoi(argv[1]) : 8;
+
+    SimulationConfig config;
+    config.final_time = argc > 2 ? atof(argv[2]) : 10;
+    config.save_freq = 0;
+
+    vector<int> seeds;
+    for (int k = 0; k < n_seeds; ++k) {
+        seeds.push_back(k + 1);
+    }
+
+    cout << "seeds " << n_seeds << ", final time " << config.final_time << ", build " << NC_BUILD_TYPE << ", "
+         << thread::hardware_concurrency() << " cores" << endl;
+
+    auto start = chrono::steady_clock::now();
+    vector<unique_ptr<Simulation>> independent;
+    for (int seed : seeds) {
+        independent.emplace_back(new Simulation(config, seed));
+        independent.back()->run();
+    }
+    const double independent_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    LockstepEnsemble ensemble(config, seeds);
+    ensemble.run();
+    const double lockstep_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int mismatches = 0;
+    for (int k = 0; k < n_seeds; ++k) {
+        if (independent[k]->density_profile() != ensemble.member(k).density_profile() ||
+            independent[k]->chemo_field() != ensemble.chemo_field(k)) {
+            cout << "seed " << seeds[k] << " differs" << endl;
+            mismatches++;
+        }
+    }
+
+    cout << "independent " << independent_seconds << " s, lockstep " << lockstep_seconds << " s, speedup "
+         << independent_seconds / lockstep_seconds << endl;
+    const string build = NC_BUILD_TYPE;
+    if (build != "Release" && build != "RelWithDebInfo" && build != "MinSizeRel") {
+        cout << "not an optimised build, the speedup does not carry over to one" << endl;
+    }
+    cout << (mismatches == 0 ? "bitwise identical" : "MISMATCH") << endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/*
+ * Compares the particle backends on the access pattern of one model step: every cell, in random order, looks for
+ * chain partners within the filopodia length, checks that the position it wants to move to is free and moves, then the
+ * search structure is updated.
+ *
+ * usage: particles_benchmark [number of cells] [number of steps]
+ *
+ * The built-in container is timed with cells in insertion order and with periodic Morton reordering, together with
+ * the cache misses of each, the Aboria backend only when built with NC_PARTICLES=aboria. Cells are inserted at random
+ * positions, like followers entering the domain at random y and then spreading out. Beyond 500 cells the domain is made
+ * longer, so that the density stays that of the model.
+ */
+
+#include "cache_counter.h"
+#include "soa_particles.h"
+
+#ifdef NC_USE_ABORIA
+#include "aboria_particles.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+const double cell_radius = 7.5;
+const double diameter = 2 * cell_radius;
+const double l_filo = 27.5;
+const double speed = 0.14;
+const double final_length = 1014; // final length of the domain
+const double length_y = 120;
+
+
+template<typename Particles>
+void fill(Particles &particles, int n_cells) {
+    const double length_x = final_length * std::max(1.0, n_cells / 500.0);
+
+    std::default_random_engine gen(1);
+    std::uniform_real_distribution<double> uniform_x(cell_radius, length_x - cell_radius);
+    std::uniform_real_distribution<double> uniform_y(cell_radius, length_y - 1 - cell_radius);
+
+    typedef typename Particles::vdouble2 vdouble2;
+
+    for (int i = 0; i < n_cells; ++i) {
+        size_t k = particles.push_back(vdouble2(uniform_x(gen), uniform_y(gen)));
+        particles.type(k) = i < 5 ? 0 : 1;
+        particles.chain(k) = i % 3;
+    }
+    particles.init_neighbour_search(vdouble2(0, 0), vdouble2(5 * length_x, 5 * length_y), diameter);
+}
+
+
+// returns seconds per step, and a checksum so that nothing is optimised away
+template<typename Particles>
+double time_steps(Particles &particles, int n_steps, long &checksum, CacheCounter &counter) {
+    typedef typename Particles::vdouble2 vdouble2;
+
+    std::default_random_engine gen(2);
+    std::uniform_real_distribution<double> uniformpi(0, 2 * M_PI);
+
+    vector<size_t> order(particles.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+
+    counter.start();
+    auto start = chrono::steady_clock::now();
+
+    for (int step = 0; step < n_steps; ++step) {
+        std::shuffle(order.begin(), order.end(), gen);
+
+        for (size_t j = 0; j < order.size(); ++j) {
+            // order holds ids, as the model does, the index may change when the container reorders
+            const size_t i = particles.index_of(int(order[j]));
+            vdouble2 x = particles.position(i);
+
+            particles.for_each_neighbour(x, l_filo, [&](size_t k) {
+                if (particles.type(k) == 0 || particles.chain(k) > 0) {
+                    checksum += long(k);
+                }
+            });
+
+            double angle = uniformpi(gen);
+            vdouble2 x_new = x + speed * vdouble2(sin(angle), cos(angle));
+            if (particles.is_free(x_new, diameter, long(i))) {
+                particles.position(i) = x_new;
+                checksum += 1;
+            }
+        }
+
+        particles.update_positions();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    counter.stop();
+
+    return seconds / n_steps;
+}
+
+
+template<typename Particles>
+void report(const string &name, Particles &particles, int n_steps) {
+    CacheCounter counter;
+    long checksum = 0;
+    double t = time_steps(particles, n_steps, checksum, counter);
+    cout << name << t * 1e6 << " us/step, " << counter.llc_misses() / n_steps << " LLC and "
+         << counter.l1d_misses() / n_steps << " L1d misses/step (checksum " << checksum << ")" << endl;
+}
+
+
+int main(int argc, char **argv) {
+
+    const int n_cells = argc > 1 ? atoi(argv[1]) : 2000;
+    const int n_steps = argc > 2 ? atoi(argv[2]) : 200;
+
+    cout << "cells " << n_cells << ", steps " << n_steps << endl;
+
+    {
+        SoaParticles particles;
+        fill(particles, n_cells);
+        report("soa, insertion order: ", particles, n_steps);
+    }
+
+    {
+        SoaParticles particles;
+        fill(particles, n_cells);
+        particles.set_reorder_interval(100);
+        particles.reorder();
+        report("soa, Morton order:    ", particles, n_steps);
+    }
+
+#ifdef NC_USE_ABORIA
+    {
+        AboriaParticles particles;
+        fill(particles, n_cells);
+        report("aboria:               ", particles, n_steps);
+    }
+#endif
+
+}
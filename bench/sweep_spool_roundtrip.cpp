@@ -0,0 +1,94 @@
+/*
+ * Checks the sweep spool (src/sweep_spool.h): the manifest gives back the parameter sets, text settings included, a
+ * worker runs every job and reports its telemetry to a .prom file of its own, and merge() combines the finished jobs,
+ * those with a NaN break proportion included, and leaves out malformed ones.
+ *
+ * usage: sweep_spool_roundtrip [directory for the spool]
+ */
+
+#include "sweep_spool.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+
+static bool file_exists(const string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+
+int main(int argc, char **argv) {
+    const string directory = string(argc > 1 ? argv[1] : ".") + "/sweep_spool_roundtrip";
+    system(("rm -rf '" + directory + "'").c_str());
+
+    try {
+        SimulationConfig config;
+        config.final_time = 1;
+        config.save_freq = 0;
+        config.telemetry = directory + "_nc.prom";
+        config.growth_cache = "";
+        config.chemo_format = "vtr";
+        vector<SimulationConfig> sets(2, config);
+        sets[1].diff_conc = 0.1;
+
+        SweepSpool::create(directory, Sweep(sets, 2));
+
+        SweepSpool spool(directory);
+        check(spool.seeds() == 2 && spool.parameter_sets().size() == 2, "seeds and parameter sets");
+        for (size_t p = 0; p < min(sets.size(), spool.parameter_sets().size()); ++p) {
+            const SimulationConfig &read = spool.parameter_sets()[p];
+            for (const string &name : SimulationConfig::parameter_names()) {
+                check(read.parameter(name) == sets[p].parameter(name), "set " + to_string(p) + ", " + name);
+            }
+            check(read.telemetry == sets[p].telemetry && read.live_view == sets[p].live_view &&
+                  read.chemo_format == sets[p].chemo_format && read.growth_cache == sets[p].growth_cache &&
+                  read.output_prefix == sets[p].output_prefix, "set " + to_string(p) + ", text settings");
+        }
+
+        check(spool.work() == 4 && spool.done() == 4 && spool.queued() == 0 && spool.claimed() == 0, "work");
+        const string prom = directory + "_nc_w" + to_string(getpid()) + ".prom";
+        check(file_exists(prom), "the worker reported no telemetry to " + prom);
+        remove(prom.c_str());
+
+        // a job without followers, whose break proportion is NaN, and a result cut short
+        spool.complete({1, 1}, VectorXi::Zero(sets[1].density_bins()), 0.0 / 0.0);
+        ofstream(directory + "/done/p0_s1.csv") << "0, 1, 0.5, 3, 4";
+        check(spool.malformed() == 1, to_string(spool.malformed()) + " malformed results, not 1");
+
+        const vector<EnsembleStats> stats = spool.merge();
+        check(stats.size() == 2, "merged parameter sets");
+        if (stats.size() == 2) {
+            check(stats[0].break_proportion().count() == 1, "a malformed result is merged");
+            check(stats[1].break_proportion().count() == 2 && std::isnan(stats[1].break_proportion().mean()),
+                  "a result with a NaN break proportion is not merged");
+        }
+    } catch (const exception &e) {
+        check(false, e.what());
+    }
+    system(("rm -rf '" + directory + "'").c_str());
+
+    cout << "sweep spool: " << (failures == 0 ? "round trip ok" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
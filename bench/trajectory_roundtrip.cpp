@@ -0,0 +1,129 @@
+/*
+ * Checks the cell trajectory format (src/cell_trajectory.h): frames of changing numbers of cells read back as they were
+ * appended, a restart drops the later frames, a frame cut short by a crash is dropped and appending carries on after it.
+ *
+ * usage: trajectory_roundtrip [directory for the file]
+ */
+
+#include "cell_trajectory.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+static int failures = 0;
+
+static void check(bool ok, const string &what) {
+    if (!ok) {
+        cout << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+
+struct frame {
+    double t;
+    int step;
+    vector<CellRecord> cells;
+};
+
+
+// n cells spread over the domain, a few of them in chains
+static frame make_frame(int k, int n, default_random_engine &gen) {
+    uniform_real_distribution<double> position(0, 1000);
+    uniform_real_distribution<double> direction(-1, 1);
+    frame f;
+    f.t = 0.5 * k;
+    f.step = 50 * k;
+    f.cells.resize(n);
+    for (int i = 0; i < n; ++i) {
+        CellRecord &c = f.cells[i];
+        memset(&c, 0, sizeof(c));
+        c.id = i;
+        c.type = i < 5 ? 0 : 1;
+        c.chain = i % 3 == 0 ? 0 : 1 + i % 4;
+        c.chain_type = c.chain > 0 ? i % 5 : -1;
+        c.attached_to_id = c.chain > 0 ? i - 1 : -1;
+        c.x = position(gen);
+        c.y = position(gen) / 10;
+        c.direction_x = direction(gen);
+        c.direction_y = direction(gen);
+    }
+    return f;
+}
+
+
+// whether frame k of the trajectory is f, record by record
+static bool same(const CellTrajectory &trajectory, int k, const frame &f) {
+    if (trajectory.time(k) != f.t || trajectory.step(k) != f.step || trajectory.cell_count(k) != int(f.cells.size())) {
+        return false;
+    }
+    return f.cells.empty() || memcmp(trajectory.cells(k), f.cells.data(), f.cells.size() * sizeof(CellRecord)) == 0;
+}
+
+
+static void check_frames(const string &path, const vector<frame> &frames, const string &what) {
+    CellTrajectory trajectory(path);
+    check(trajectory.size() == int(frames.size()), what + ": " + to_string(trajectory.size()) + " frames, not " +
+                                                   to_string(frames.size()));
+    for (int k = 0; k < min(trajectory.size(), int(frames.size())); ++k) {
+        check(same(trajectory, k, frames[k]), what + ": frame " + to_string(k));
+    }
+}
+
+
+static void append(const string &path, const frame &f) {
+    append_cell_frame(path, f.t, f.step, f.cells);
+}
+
+
+int main(int argc, char **argv) {
+    const string path = string(argc > 1 ? argv[1] : ".") + "/trajectory_roundtrip.nct";
+    remove(path.c_str());
+
+    try {
+        default_random_engine gen(1);
+        const int counts[] = {10, 17, 0, 42, 23};
+        vector<frame> frames;
+        for (int k = 0; k < 5; ++k) {
+            frames.push_back(make_frame(k, counts[k], gen));
+            append(path, frames[k]);
+        }
+        check_frames(path, frames, "appended");
+        {
+            CellTrajectory trajectory(path);
+            check(trajectory.find(1.2) == 2 && trajectory.find(-1) == 0, "find");
+        }
+
+        // a crash within the last frame drops it, appending then carries on after the one before
+        struct stat status;
+        check(stat(path.c_str(), &status) == 0, "stat");
+        check(truncate(path.c_str(), status.st_size - 100) == 0, "truncate");
+        frames.pop_back();
+        check_frames(path, frames, "with a frame cut short");
+        frames.push_back(make_frame(4, 31, gen));
+        append(path, frames.back());
+        check_frames(path, frames, "appending after a crash");
+
+        // a restart from step 100 replaces the frames from there on
+        frames.resize(2);
+        frames.push_back(make_frame(2, 19, gen));
+        append(path, frames.back());
+        check_frames(path, frames, "after a restart");
+    } catch (const exception &e) {
+        check(false, e.what());
+    }
+    remove(path.c_str());
+
+    cout << "cell trajectory: " << (failures == 0 ? "round trip ok" : "FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+# Writes the hash of the model sources and of BUILD, the particle backend, compiler, build type, flags and definitions
+# they are built with, to OUTPUT as NC_CODE_VERSION, run at every build. The file is only rewritten when the hash
+# changed, so that nothing is recompiled otherwise.
+#
+#     cmake -DSOURCE_DIR=<source directory> -DOUTPUT=<header> -DBUILD=<build configuration> -P code_version.cmake
+
+file(GLOB sources ${SOURCE_DIR}/src/*.h ${SOURCE_DIR}/src/*.cpp)
+list(SORT sources)
+
+set(hashes "")
+foreach (source ${sources})
+    file(SHA256 ${source} hash)
+    string(APPEND hashes ${hash})
+endforeach ()
+
+string(SHA256 version "${hashes}${BUILD}")
+string(SUBSTRING ${version} 0 16 version)
+
+set(content "#define NC_CODE_VERSION \"${version}\"\n")
+set(old "")
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} old)
+endif ()
+if (NOT old STREQUAL content)
+    file(WRITE ${OUTPUT} "${content}")
+endif ()
@@ -0,0 +1,83 @@
+/*
+ * One simulation of the model split over MPI ranks in slabs along the domain (src/slab_simulation.h), e.g.
+ *
+ *     mpirun -np 4 ./main_mpi [final_time] [seed] [space_grid_controller]
+ *
+ * Rank 0 reports the slabs and the cells in them whenever they are rebalanced, and writes the density of cells along
+ * the domain at the end to DensityOfCellsAlongTheDomain.csv, as main does.
+ */
+
+
+#include "slab_simulation.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static void report(const SlabSimulation &simulation) {
+    const int local[3] = {simulation.slab_begin(), simulation.slab_end(), simulation.local_cells()};
+    vector<int> all(3 * simulation.ranks());
+    MPI_Gather(local, 3, MPI_INT, all.data(), 3, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (simulation.rank() == 0) {
+        cout << "t = " << simulation.time() << ":";
+        for (int r = 0; r < simulation.ranks(); r++) {
+            cout << "  rank " << r << " columns " << all[3 * r] << "-" << all[3 * r + 1] << " cells " << all[3 * r + 2];
+        }
+        cout << endl;
+    }
+}
+
+
+int main(int argc, char **argv) {
+
+    MPI_Init(&argc, &argv);
+
+    SimulationConfig config;
+    int seed = 0;
+    if (argc > 1) {
+        config.final_time = atof(argv[1]);
+    }
+    if (argc > 2) {
+        seed = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        config.space_grid_controller = atof(argv[3]);
+    }
+
+    try {
+        SlabSimulation simulation(config, seed);
+        report(simulation);
+
+        while (!simulation.finished()) {
+            simulation.step();
+            if (simulation.step_count() % simulation.rebalance_interval() == 0) {
+                report(simulation);
+            }
+        }
+
+        const VectorXi density = simulation.density_profile();
+        const double pro_break = simulation.break_proportion();
+        const long cells = simulation.total_cells();
+
+        if (simulation.rank() == 0) {
+            cout << cells << " cells, break proportion " << pro_break << endl;
+
+            ofstream output("DensityOfCellsAlongTheDomain.csv");
+            for (int i = 0; i < density.size(); i++) {
+                output << density(i) << ", " << "\n" << endl;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Finalize();
+}
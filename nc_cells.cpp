@@ -0,0 +1,401 @@
+/*
+ * Python module nc_cells, for driving and inspecting simulations without going through files, e.g.
+ *
+ *     import numpy as np, nc_cells
+ *     s = nc_cells.Simulation({"final_time": 18, "save_freq": 0, "chemo_format": "csv"}, seed=3)
+ *     while not s.finished:
+ *         s.step(100)
+ *         chemo = np.asarray(s.chemo)   # length_x by length_y, no copy
+ *         positions = np.asarray(s.positions)   # a copy, the cells move in memory as they step
+ *
+ * The parameters are the names of SimulationConfig, numeric ones as in SimulationConfig::set_parameter and the strings
+ * output_prefix, chemo_format, growth_cache, live_view and telemetry. step(), run() and the checkpoints release the GIL,
+ * so Python threads can step several simulations at once; a simulation itself is used by one thread at a time.
+ *
+ * Only the grids, chemo and gamma, are zero-copy: read-only views of the simulation's own memory through the buffer
+ * protocol, which numpy.asarray and memoryview wrap without copying. They stay where they are for the life of the
+ * simulation, and a view keeps its simulation alive. The fields of the cells are not views but copies, made every time
+ * one is read, through the same buffer protocol: a step may add cells or reorder them, which moves their storage, so
+ * an array of them in place would read freed memory after the next step. A copy is one pass over the cells, little
+ * next to a timestep.
+ */
+
+
+#include "simulation.h"
+
+#include <Python.h>
+#include <boost/python.hpp>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef NC_USE_ABORIA
+#error "the Python module reads the cells in place and needs the soa particle backend"
+#endif
+
+using namespace std;
+using namespace Eigen;
+namespace py = boost::python;
+
+
+/*
+ * views
+ */
+
+// a read-only strided array in the memory of owner, or in copy
+struct ArrayView {
+    PyObject_HEAD
+    PyObject *owner;
+    std::vector<char> *copy; // the elements if the view owns them
+    char *data;
+    const char *format; // struct module format of an element
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2]; // in bytes
+};
+
+static PyTypeObject array_view_type;
+
+
+static void array_view_dealloc(PyObject *self) {
+    Py_XDECREF(reinterpret_cast<ArrayView *>(self)->owner);
+    delete reinterpret_cast<ArrayView *>(self)->copy;
+    Py_TYPE(self)->tp_free(self);
+}
+
+
+static int array_view_getbuffer(PyObject *self, Py_buffer *buffer, int flags) {
+    ArrayView *view = reinterpret_cast<ArrayView *>(self);
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "simulation views are read-only");
+        return -1;
+    }
+
+    // consumers that cannot take strides only get the views that are C contiguous
+    bool contiguous = true;
+    Py_ssize_t expected = view->itemsize;
+    for (int d = view->ndim - 1; d >= 0; --d) {
+        contiguous = contiguous && (view->shape[d] < 2 || view->strides[d] == expected);
+        expected *= view->shape[d];
+    }
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES && !contiguous) {
+        PyErr_SetString(PyExc_BufferError, "simulation view is not contiguous, request strides");
+        return -1;
+    }
+
+    Py_ssize_t n = 1;
+    for (int d = 0; d < view->ndim; ++d) {
+        n *= view->shape[d];
+    }
+
+    buffer->buf = view->data;
+    buffer->obj = self;
+    Py_INCREF(self);
+    buffer->len = n * view->itemsize;
+    buffer->itemsize = view->itemsize;
+    buffer->readonly = 1;
+    buffer->ndim = view->ndim;
+    buffer->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(view->format) : nullptr;
+    buffer->shape = (flags & PyBUF_ND) == PyBUF_ND ? view->shape : nullptr;
+    buffer->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? view->strides : nullptr;
+    buffer->suboffsets = nullptr;
+    buffer->internal = nullptr;
+    return 0;
+}
+
+
+static PyBufferProcs array_view_buffer = {array_view_getbuffer, nullptr};
+
+
+static void init_array_view_type() {
+    array_view_type.tp_name = "nc_cells.ArrayView";
+    array_view_type.tp_basicsize = sizeof(ArrayView);
+    array_view_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    array_view_type.tp_doc = "Read-only array of a simulation, for numpy.asarray or memoryview.";
+    array_view_type.tp_dealloc = array_view_dealloc;
+    array_view_type.tp_as_buffer = &array_view_buffer;
+    array_view_type.tp_new = nullptr; // only made by the simulations
+    if (PyType_Ready(&array_view_type) < 0) {
+        py::throw_error_already_set();
+    }
+}
+
+
+// empty arrays still need an address
+static double no_data;
+
+
+// rows by columns elements of itemsize bytes, columns 0 for a vector, strides in bytes, in the memory of owner
+static py::object make_view(const py::object &owner, const void *data, const char *format, Py_ssize_t itemsize,
+                            Py_ssize_t rows, Py_ssize_t row_stride, Py_ssize_t columns = 0,
+                            Py_ssize_t column_stride = 0) {
+    ArrayView *view = PyObject_New(ArrayView, &array_view_type);
+    if (!view) {
+        py::throw_error_already_set();
+    }
+    view->owner = owner.ptr();
+    Py_INCREF(view->owner);
+    view->copy = nullptr;
+    view->data = const_cast<char *>(static_cast<const char *>(rows > 0 ? data : &no_data));
+    view->format = format;
+    view->itemsize = itemsize;
+    view->ndim = columns > 0 ? 2 : 1;
+    view->shape[0] = rows;
+    view->strides[0] = row_stride;
+    view->shape[1] = columns;
+    view->strides[1] = column_stride;
+    return py::object(py::handle<>(reinterpret_cast<PyObject *>(view)));
+}
+
+
+// as make_view, but of a C contiguous copy of the elements that the view owns
+static py::object make_copy(const void *data, const char *format, Py_ssize_t itemsize, Py_ssize_t rows,
+                            Py_ssize_t row_stride, Py_ssize_t columns = 0, Py_ssize_t column_stride = 0) {
+    const Py_ssize_t n = columns > 0 ? columns : 1;
+    unique_ptr<vector<char>> copy(new vector<char>(size_t(rows * n * itemsize)));
+    const char *source = static_cast<const char *>(data);
+    for (Py_ssize_t i = 0; i < rows; ++i) {
+        for (Py_ssize_t j = 0; j < n; ++j) {
+            memcpy(copy->data() + (i * n + j) * itemsize, source + i * row_stride + j * column_stride, size_t(itemsize));
+        }
+    }
+    py::object view = make_view(py::object(), copy->data(), format, itemsize, rows, n * itemsize, columns, itemsize);
+    reinterpret_cast<ArrayView *>(view.ptr())->copy = copy.release();
+    return view;
+}
+
+
+static const Simulation &simulation_of(const py::object &self) {
+    return py::extract<const Simulation &>(self);
+}
+
+
+// length_x by length_y, column major as Eigen stores it
+static py::object chemo_view(const py::object &self) {
+    const MatrixXd &chemo = simulation_of(self).chemo_field();
+    return make_view(self, chemo.data(), "d", sizeof(double), chemo.rows(), sizeof(double), chemo.cols(),
+                     chemo.rows() * sizeof(double));
+}
+
+
+static py::object gamma_view(const py::object &self) {
+    const VectorXd &gamma = simulation_of(self).gamma();
+    return make_view(self, gamma.data(), "d", sizeof(double), gamma.size(), sizeof(double));
+}
+
+
+/*
+ * copies of the fields of the cells, in the order of the container: ids gives the id of the cell at each index
+ */
+
+static py::object positions_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    return make_copy(cells.position_data(), "d", sizeof(double), cells.size(), sizeof(vdouble2), 2,
+                     sizeof(double));
+}
+
+
+static py::object directions_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    const void *data = cells.size() ? &cells.cold_data()->direction : nullptr;
+    return make_copy(data, "d", sizeof(double), cells.size(),
+                     sizeof(SoaParticles::cold_fields), 2, sizeof(double));
+}
+
+
+static py::object ids_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    return make_copy(cells.id_data(), "i", sizeof(int), cells.size(), sizeof(int));
+}
+
+
+static py::object types_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    return make_copy(cells.type_data(), "i", sizeof(int), cells.size(), sizeof(int));
+}
+
+
+static py::object chains_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    return make_copy(cells.chain_data(), "i", sizeof(int), cells.size(), sizeof(int));
+}
+
+
+static py::object attached_to_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    const void *data = cells.size() ? &cells.cold_data()->attached_to_id : nullptr;
+    return make_copy(data, "i", sizeof(int), cells.size(),
+                     sizeof(SoaParticles::cold_fields));
+}
+
+
+static py::object chain_types_copy(const py::object &self) {
+    const particle_type &cells = simulation_of(self).cells();
+    const void *data = cells.size() ? &cells.cold_data()->chain_type : nullptr;
+    return make_copy(data, "i", sizeof(int), cells.size(),
+                     sizeof(SoaParticles::cold_fields));
+}
+
+
+/*
+ * construction and stepping
+ */
+
+// the string parameters, which set_parameter does not take
+static string *string_parameter(SimulationConfig &config, const string &name) {
+    if (name == "output_prefix") {
+        return &config.output_prefix;
+    } else if (name == "chemo_format") {
+        return &config.chemo_format;
+    } else if (name == "growth_cache") {
+        return &config.growth_cache;
+    } else if (name == "live_view") {
+        return &config.live_view;
+    } else if (name == "telemetry") {
+        return &config.telemetry;
+    }
+    return nullptr;
+}
+
+
+// the defaults with the entries of parameters, unknown names raise ValueError
+static SimulationConfig config_from(const py::dict &parameters) {
+    SimulationConfig config;
+    const py::list items = parameters.items();
+    for (py::ssize_t k = 0; k < py::len(items); ++k) {
+        const string name = py::extract<string>(items[k][0]);
+        const py::object value = items[k][1];
+        string *text = string_parameter(config, name);
+        if (text) {
+            *text = py::extract<string>(value)();
+        } else {
+            config.set_parameter(name, py::extract<double>(value)());
+        }
+    }
+    return config;
+}
+
+
+static py::dict parameters_of(const SimulationConfig &config) {
+    py::dict parameters;
+    for (const string &name : SimulationConfig::parameter_names()) {
+        parameters[name] = config.parameter(name);
+    }
+    SimulationConfig copy = config;
+    for (const char *name : {"output_prefix", "chemo_format", "growth_cache", "live_view", "telemetry"}) {
+        parameters[name] = *string_parameter(copy, name);
+    }
+    return parameters;
+}
+
+
+static py::dict default_parameters() {
+    return parameters_of(SimulationConfig());
+}
+
+
+static py::dict simulation_parameters(const Simulation &simulation) {
+    return parameters_of(simulation.configuration());
+}
+
+
+static shared_ptr<Simulation> make_simulation(const py::dict &parameters, int seed) {
+    return make_shared<Simulation>(config_from(parameters), seed);
+}
+
+
+// the GIL is released while it lives, taken back on the way out, exceptions included
+class WithoutGil {
+public:
+    WithoutGil() : state(PyEval_SaveThread()) {}
+
+    ~WithoutGil() { PyEval_RestoreThread(state); }
+
+    WithoutGil(const WithoutGil &) = delete;
+
+    WithoutGil &operator=(const WithoutGil &) = delete;
+
+private:
+    PyThreadState *state;
+};
+
+
+// up to n timesteps, fewer if final_time is reached, returns the number taken
+static int step(Simulation &simulation, int n) {
+    WithoutGil unlocked;
+    int taken = 0;
+    while (taken < n && !simulation.finished()) {
+        simulation.step();
+        taken++;
+    }
+    return taken;
+}
+
+
+static void run(Simulation &simulation) {
+    WithoutGil unlocked;
+    simulation.run();
+}
+
+
+static void write_checkpoint(const Simulation &simulation, const string &path) {
+    WithoutGil unlocked;
+    simulation.write_checkpoint(path);
+}
+
+
+static void read_checkpoint(Simulation &simulation, const string &path) {
+    WithoutGil unlocked;
+    simulation.read_checkpoint(path);
+}
+
+
+static py::list density_profile(const Simulation &simulation) {
+    const VectorXi density = simulation.density_profile();
+    py::list bins;
+    for (int i = 0; i < density.size(); ++i) {
+        bins.append(density(i));
+    }
+    return bins;
+}
+
+
+BOOST_PYTHON_MODULE (nc_cells) {
+    init_array_view_type();
+    py::scope().attr("ArrayView") = py::object(py::handle<>(py::borrowed(reinterpret_cast<PyObject *>(
+            &array_view_type))));
+
+    py::def("default_parameters", default_parameters, "The parameters of SimulationConfig and their defaults.");
+
+    py::class_<Simulation, shared_ptr<Simulation>, boost::noncopyable>("Simulation", py::no_init)
+            .def("__init__", py::make_constructor(make_simulation, py::default_call_policies(),
+                                                  (py::arg("parameters") = py::dict(), py::arg("seed") = 0)),
+                 "A simulation with the defaults overridden by the parameters dict.")
+            .def("step", step, (py::arg("n") = 1),
+                 "Advances up to n timesteps, fewer if final_time is reached, and returns the number taken.")
+            .def("run", run, "Steps until final_time.")
+            .def("reset", &Simulation::reset, py::arg("seed"), "Starts again from the initial conditions.")
+            .def("set_threads", &Simulation::set_threads, py::arg("n"), "Threads for the chemoattractant phases.")
+            .def("write_checkpoint", write_checkpoint, py::arg("path"))
+            .def("read_checkpoint", read_checkpoint, py::arg("path"))
+            .def("density_profile", density_profile, "Cells in each 55 um part of the domain.")
+            .def("break_proportion", &Simulation::break_proportion, "The proportion of followers not in a chain.")
+            .add_property("parameters", simulation_parameters)
+            .add_property("finished", &Simulation::finished)
+            .add_property("time", &Simulation::time)
+            .add_property("step_count", &Simulation::step_count)
+            .add_property("threads", &Simulation::threads)
+            .add_property("chemo", chemo_view, "Chemoattractant, length_x by length_y.")
+            .add_property("gamma", gamma_view, "Position of every grid column on the grown domain.")
+            .add_property("positions", positions_copy, "Position of every cell, a copy.")
+            .add_property("directions", directions_copy, "Last move of every cell, a copy.")
+            .add_property("ids", ids_copy, "Id of every cell, a copy.")
+            .add_property("types", types_copy, "0 for leaders, 1 for followers, a copy.")
+            .add_property("chains", chains_copy, "Place of each cell in its chain, 0 if in none, a copy.")
+            .add_property("attached_to", attached_to_copy, "Id of the cell each one follows, a copy.")
+            .add_property("chain_types", chain_types_copy,
+                          "Id of the leader at the front of each chain, a copy.");
+}
@@ -0,0 +1,153 @@
+/*
+ * Aboria backend for the NC cell model, wraps Aboria's Particles in the same interface as SoaParticles.
+ *
+ * Aboria ids are unique and, since cells are never removed and the default cell list does not reorder particles,
+ * they coincide with the index of the cell, which is what the neighbour search functors are given. For the same
+ * reason index_of is the identity and Morton reordering is not offered.
+ */
+
+#ifndef NC_ABORIA_PARTICLES_H
+#define NC_ABORIA_PARTICLES_H
+
+#include "Aboria.h"
+
+#include <cstddef>
+#include <iosfwd>
+#include <stdexcept>
+#include <tuple>
+
+
+namespace aboria_fields {
+    ABORIA_VARIABLE(radius, double, "radius")
+    ABORIA_VARIABLE(direction, Aboria::vdouble2, "direction")// stores the direction a particle moved
+    ABORIA_VARIABLE(persistence_extent, int,
+                    "persistence extent")// stores whether cell moves only one step in current direction or in a process
+    // of moving persistently
+    ABORIA_VARIABLE(same_dir_step, int,
+                    "same dir step")// the number which stores how many steps in the same direction are made.
+    ABORIA_VARIABLE(attached_to_id, int, "attached_to_id")
+    ABORIA_VARIABLE(type, int, "type") // 0 if a cell is a leader, 1 if follower
+    ABORIA_VARIABLE(chain_type, int, "chain_type") // leaders form different chain types
+    ABORIA_VARIABLE(chain, int, "chain") // stores whether a follower is part of the chain or no
+    ABORIA_VARIABLE(scaling, int, "scaling ") // index of Gamma the position is scaled down to
+}
+
+
+class AboriaParticles {
+public:
+
+    typedef Aboria::vdouble2 vdouble2;
+
+    typedef Aboria::Particles<std::tuple<aboria_fields::radius, aboria_fields::type, aboria_fields::attached_to_id,
+            aboria_fields::direction, aboria_fields::chain, aboria_fields::chain_type,
+            aboria_fields::persistence_extent, aboria_fields::same_dir_step, aboria_fields::scaling>, 2>
+            container_type;
+    // 2 stands for dimension
+
+    typedef container_type::position position_variable;
+
+    explicit AboriaParticles(size_t n = 0) : particles_(n) {}
+
+    size_t size() const { return particles_.size(); }
+
+    // bin_size is not used, Aboria chooses its own bucket size
+    void init_neighbour_search(const vdouble2 &low, const vdouble2 &high, double bin_size) {
+        particles_.init_neighbour_search(low, high, Aboria::vbool2(false, false));
+    }
+
+    size_t push_back(const vdouble2 &x) {
+        container_type::value_type p;
+        Aboria::get<position_variable>(p) = x;
+        Aboria::get<aboria_fields::radius>(p) = 0;
+        Aboria::get<aboria_fields::type>(p) = 0;
+        Aboria::get<aboria_fields::attached_to_id>(p) = 0;
+        Aboria::get<aboria_fields::direction>(p) = vdouble2(0, 0);
+        Aboria::get<aboria_fields::chain>(p) = 0;
+        Aboria::get<aboria_fields::chain_type>(p) = 0;
+        Aboria::get<aboria_fields::persistence_extent>(p) = 0;
+        Aboria::get<aboria_fields::same_dir_step>(p) = 0;
+        Aboria::get<aboria_fields::scaling>(p) = 0;
+        particles_.push_back(p);
+        return particles_.size() - 1;
+    }
+
+    void update_positions() { particles_.update_positions(); }
+
+    void set_reorder_interval(int n) {}
+
+    void reorder() {}
+
+    size_t index_of(int id) const { return size_t(id); }
+
+    // Aboria's search structure cannot be restored exactly, so there are no checkpoints with this backend
+    void write(std::ostream &out) const {
+        throw std::runtime_error("checkpoints need the built-in particle container (NC_PARTICLES=soa)");
+    }
+
+    void read(std::istream &in) {
+        throw std::runtime_error("checkpoints need the built-in particle container (NC_PARTICLES=soa)");
+    }
+
+    vdouble2 &position(size_t i) { return Aboria::get<position_variable>(particles_)[i]; }
+
+    const vdouble2 &position(size_t i) const { return Aboria::get<position_variable>(particles_)[i]; }
+
+    int id(size_t i) const { return Aboria::get<Aboria::id>(particles_)[i]; }
+
+    int &type(size_t i) { return Aboria::get<aboria_fields::type>(particles_)[i]; }
+
+    int type(size_t i) const { return Aboria::get<aboria_fields::type>(particles_)[i]; }
+
+    int &chain(size_t i) { return Aboria::get<aboria_fields::chain>(particles_)[i]; }
+
+    int chain(size_t i) const { return Aboria::get<aboria_fields::chain>(particles_)[i]; }
+
+    vdouble2 &direction(size_t i) { return Aboria::get<aboria_fields::direction>(particles_)[i]; }
+
+    const vdouble2 &direction(size_t i) const { return Aboria::get<aboria_fields::direction>(particles_)[i]; }
+
+    double &radius(size_t i) { return Aboria::get<aboria_fields::radius>(particles_)[i]; }
+
+    int &attached_to_id(size_t i) { return Aboria::get<aboria_fields::attached_to_id>(particles_)[i]; }
+
+    int attached_to_id(size_t i) const { return Aboria::get<aboria_fields::attached_to_id>(particles_)[i]; }
+
+    int &chain_type(size_t i) { return Aboria::get<aboria_fields::chain_type>(particles_)[i]; }
+
+    int chain_type(size_t i) const { return Aboria::get<aboria_fields::chain_type>(particles_)[i]; }
+
+    int &persistence_extent(size_t i) { return Aboria::get<aboria_fields::persistence_extent>(particles_)[i]; }
+
+    int &same_dir_step(size_t i) { return Aboria::get<aboria_fields::same_dir_step>(particles_)[i]; }
+
+    int &scaling(size_t i) { return Aboria::get<aboria_fields::scaling>(particles_)[i]; }
+
+    template<typename F>
+    void for_each_neighbour(const vdouble2 &x, double r, F f) const {
+        for (auto k = Aboria::euclidean_search(particles_.get_query(), x, r); k != false; ++k) {
+            f(size_t(Aboria::get<Aboria::id>(*k)));
+        }
+    }
+
+    template<typename Pred>
+    bool any_neighbour(const vdouble2 &x, double r, Pred pred) const {
+        for (auto k = Aboria::euclidean_search(particles_.get_query(), x, r); k != false; ++k) {
+            if (pred(size_t(Aboria::get<Aboria::id>(*k)))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool is_free(const vdouble2 &x, double r, long self = -1) const {
+        return !any_neighbour(x, r, [self](size_t j) { return long(j) != self; });
+    }
+
+    // the underlying container, e.g. for vtkWriteGrid
+    container_type &aboria() { return particles_; }
+
+private:
+    container_type particles_;
+};
+
+#endif //NC_ABORIA_PARTICLES_H
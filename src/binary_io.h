@@ -0,0 +1,104 @@
+/*
+ * Raw binary reading and writing of plain values, vectors and Eigen matrices, for checkpoints and binary output. The
+ * bytes are those of the machine, so files are only read back on the same architecture. The readers leave the stream
+ * failed on a short read, callers check it once at the end.
+ */
+
+#ifndef NC_BINARY_IO_H
+#define NC_BINARY_IO_H
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+template<typename T>
+void write_binary(std::ostream &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+void read_binary(std::istream &in, T &value) {
+    in.read(reinterpret_cast<char *>(&value), sizeof(T));
+}
+
+
+template<typename T>
+void write_binary(std::ostream &out, const std::vector<T> &v) {
+    write_binary(out, std::uint64_t(v.size()));
+    out.write(reinterpret_cast<const char *>(v.data()), std::streamsize(v.size() * sizeof(T)));
+}
+
+template<typename T>
+void read_binary(std::istream &in, std::vector<T> &v) {
+    std::uint64_t n = 0;
+    read_binary(in, n);
+    if (!in) {
+        return;
+    }
+    v.resize(size_t(n));
+    in.read(reinterpret_cast<char *>(v.data()), std::streamsize(v.size() * sizeof(T)));
+}
+
+
+inline void write_binary(std::ostream &out, const std::string &s) {
+    write_binary(out, std::uint64_t(s.size()));
+    out.write(s.data(), std::streamsize(s.size()));
+}
+
+inline void read_binary(std::istream &in, std::string &s) {
+    std::uint64_t n = 0;
+    read_binary(in, n);
+    if (!in) {
+        return;
+    }
+    s.resize(size_t(n));
+    in.read(&s[0], std::streamsize(s.size()));
+}
+
+
+template<typename Scalar, int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+void write_binary(std::ostream &out, const Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols> &m) {
+    write_binary(out, std::int64_t(m.rows()));
+    write_binary(out, std::int64_t(m.cols()));
+    out.write(reinterpret_cast<const char *>(m.data()), std::streamsize(m.size() * sizeof(Scalar)));
+}
+
+template<typename Scalar, int Rows, int Cols, int Options, int MaxRows, int MaxCols>
+void read_binary(std::istream &in, Eigen::Matrix<Scalar, Rows, Cols, Options, MaxRows, MaxCols> &m) {
+    std::int64_t rows = 0, cols = 0;
+    read_binary(in, rows);
+    read_binary(in, cols);
+    if (!in) {
+        return;
+    }
+    m.resize(Eigen::Index(rows), Eigen::Index(cols));
+    in.read(reinterpret_cast<char *>(m.data()), std::streamsize(m.size() * sizeof(Scalar)));
+}
+
+
+// random number engines, through their text representation
+template<typename Engine>
+void write_engine(std::ostream &out, const Engine &engine) {
+    std::ostringstream state;
+    state << engine;
+    write_binary(out, state.str());
+}
+
+template<typename Engine>
+void read_engine(std::istream &in, Engine &engine) {
+    std::string s;
+    read_binary(in, s);
+    std::istringstream state(s);
+    state >> engine;
+    if (!state) {
+        in.setstate(std::ios::failbit);
+    }
+}
+
+#endif //NC_BINARY_IO_H
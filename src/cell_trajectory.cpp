@@ -0,0 +1,192 @@
+#include "cell_trajectory.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+static const char trajectory_magic[16] = {'n', 'c', ' ', 'c', 'e', 'l', 'l', ' ', 'f', 'r', 'a', 'm', 'e', 's', 0, 0};
+static const uint32_t trajectory_version = 1;
+
+static const uint32_t frame_magic = 0x4e434652;
+static const uint32_t frame_end_magic = 0x4e434645;
+
+
+struct trajectory_header {
+    char magic[16];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct frame_header {
+    uint32_t magic;
+    uint32_t n;
+    double t;
+    int64_t step;
+};
+
+struct frame_trailer {
+    uint64_t offset; // of the frame header
+    uint32_t magic;
+    uint32_t n;
+};
+
+
+static uint64_t frame_size(uint32_t n) {
+    return sizeof(frame_header) + uint64_t(n) * sizeof(CellRecord) + sizeof(frame_trailer);
+}
+
+
+static bool valid_header(const trajectory_header &header) {
+    return memcmp(header.magic, trajectory_magic, sizeof(header.magic)) == 0 &&
+           header.version == trajectory_version && header.record_size == sizeof(CellRecord);
+}
+
+
+static bool read_at(int fd, void *data, size_t size, uint64_t offset) {
+    return pread(fd, data, size, off_t(offset)) == ssize_t(size);
+}
+
+
+// where the frame of step goes: after the last frame if that is complete and of an earlier step, otherwise after the
+// last complete frame of an earlier step, found by walking the frames
+static uint64_t append_position(int fd, uint64_t size, int step) {
+    frame_trailer trailer;
+    frame_header last;
+    if (size >= sizeof(trajectory_header) + frame_size(0) &&
+        read_at(fd, &trailer, sizeof(trailer), size - sizeof(trailer)) && trailer.magic == frame_end_magic &&
+        trailer.offset + frame_size(trailer.n) == size &&
+        read_at(fd, &last, sizeof(last), trailer.offset) && last.magic == frame_magic && last.n == trailer.n &&
+        last.step < step) {
+        return size;
+    }
+
+    uint64_t end = sizeof(trajectory_header);
+    frame_header frame;
+    while (end + sizeof(frame) <= size && read_at(fd, &frame, sizeof(frame), end) && frame.magic == frame_magic &&
+           end + frame_size(frame.n) <= size && frame.step < step) {
+        end += frame_size(frame.n);
+    }
+    return end;
+}
+
+
+void append_cell_frame(const string &path, double t, int step, const vector<CellRecord> &cells) {
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw runtime_error("cannot write the cell trajectory " + path + ": " + strerror(errno));
+    }
+
+    string error;
+    struct stat info;
+    uint64_t end = 0;
+    if (fstat(fd, &info) != 0) {
+        error = strerror(errno);
+    } else if (info.st_size == 0) {
+        trajectory_header header;
+        memcpy(header.magic, trajectory_magic, sizeof(header.magic));
+        header.version = trajectory_version;
+        header.record_size = sizeof(CellRecord);
+        if (pwrite(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))) {
+            error = strerror(errno);
+        }
+        end = sizeof(header);
+    } else {
+        trajectory_header header;
+        if (!read_at(fd, &header, sizeof(header), 0) || !valid_header(header)) {
+            close(fd);
+            throw runtime_error(path + " is not a cell trajectory");
+        }
+        end = append_position(fd, uint64_t(info.st_size), step);
+        if (end != uint64_t(info.st_size) && ftruncate(fd, off_t(end)) != 0) {
+            error = strerror(errno);
+        }
+    }
+
+    if (error.empty()) {
+        frame_header header;
+        header.magic = frame_magic;
+        header.n = uint32_t(cells.size());
+        header.t = t;
+        header.step = step;
+        frame_trailer trailer;
+        trailer.offset = end;
+        trailer.magic = frame_end_magic;
+        trailer.n = header.n;
+
+        string bytes(size_t(frame_size(header.n)), '\0');
+        memcpy(&bytes[0], &header, sizeof(header));
+        if (!cells.empty()) {
+            memcpy(&bytes[sizeof(header)], cells.data(), cells.size() * sizeof(CellRecord));
+        }
+        memcpy(&bytes[bytes.size() - sizeof(trailer)], &trailer, sizeof(trailer));
+
+        if (pwrite(fd, bytes.data(), bytes.size(), off_t(end)) != ssize_t(bytes.size())) {
+            error = strerror(errno);
+        }
+    }
+
+    close(fd);
+    if (!error.empty()) {
+        throw runtime_error("cannot write the cell trajectory " + path + ": " + error);
+    }
+}
+
+
+CellTrajectory::CellTrajectory(const string &path) : mapping(nullptr), mapping_size(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("cannot read the cell trajectory " + path + ": " + strerror(errno));
+    }
+    struct stat info;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && uint64_t(info.st_size) >= sizeof(trajectory_header)) {
+        p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw runtime_error(path + " is not a cell trajectory");
+    }
+    mapping = p;
+    mapping_size = size_t(info.st_size);
+
+    const char *bytes = static_cast<const char *>(mapping);
+    trajectory_header header;
+    memcpy(&header, bytes, sizeof(header));
+    if (!valid_header(header)) {
+        munmap(mapping, mapping_size);
+        throw runtime_error(path + " is not a cell trajectory");
+    }
+
+    // up to the first incomplete frame, the one a crash may have left
+    uint64_t offset = sizeof(header);
+    while (offset + sizeof(frame_header) <= mapping_size) {
+        frame_header f;
+        memcpy(&f, bytes + offset, sizeof(f));
+        if (f.magic != frame_magic || offset + frame_size(f.n) > mapping_size) {
+            break;
+        }
+        frames.push_back(frame{f.t, f.step, f.n, reinterpret_cast<const CellRecord *>(bytes + offset + sizeof(f))});
+        offset += frame_size(f.n);
+    }
+}
+
+
+CellTrajectory::~CellTrajectory() {
+    munmap(mapping, mapping_size);
+}
+
+
+int CellTrajectory::find(double t) const {
+    const auto after = upper_bound(frames.begin(), frames.end(), t,
+                                   [](double time, const frame &f) { return time < f.t; });
+    return after == frames.begin() ? 0 : int(after - frames.begin()) - 1;
+}
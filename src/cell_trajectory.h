@@ -0,0 +1,84 @@
+/*
+ * The cells of every save of a run in one binary file, for trajectory analysis without VTK.
+ *
+ *     header   "nc cell frames\0\0", version, size of a record
+ *     frame    magic, number of cells, time, step, one record per cell in the order of their ids, offset of the frame
+ *     ...
+ *
+ * The number of cells may change from frame to frame. A frame ends with its own offset, so the writer finds the last
+ * frame from the end of the file and appends in constant time. Appending a step that is not after the last one, as
+ * after a restart from a checkpoint, drops the later frames; a frame cut short by a crash is dropped as well.
+ *
+ * CellTrajectory maps the file read-only and indexes the frames, the records of a frame are then read in place. Numbers
+ * are stored in the byte order of the machine, files are read back on the same architecture.
+ */
+
+#ifndef NC_CELL_TRAJECTORY_H
+#define NC_CELL_TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct CellRecord {
+    std::int32_t id;
+    std::int32_t type; // 0 leader, 1 follower
+    std::int32_t chain; // place in its chain, 1 behind the leader, 0 if in none
+    std::int32_t chain_type; // id of the leader at the front of its chain
+    std::int32_t attached_to_id; // id of the cell it follows
+    std::int32_t unused;
+    double x;
+    double y;
+    double direction_x;
+    double direction_y;
+};
+
+
+// appends a frame to the trajectory at path, which is created if missing, throws std::runtime_error if it cannot be
+// written
+void append_cell_frame(const std::string &path, double t, int step, const std::vector<CellRecord> &cells);
+
+
+class CellTrajectory {
+public:
+
+    // maps the file and indexes its frames, throws std::runtime_error if path is not a cell trajectory
+    explicit CellTrajectory(const std::string &path);
+
+    ~CellTrajectory();
+
+    CellTrajectory(const CellTrajectory &) = delete;
+
+    CellTrajectory &operator=(const CellTrajectory &) = delete;
+
+    int size() const { return int(frames.size()); }
+
+    double time(int k) const { return frames[k].t; }
+
+    int step(int k) const { return int(frames[k].step); }
+
+    int cell_count(int k) const { return int(frames[k].n); }
+
+    // the records of frame k, valid while the trajectory is open
+    const CellRecord *cells(int k) const { return frames[k].cells; }
+
+    // the last frame at or before t, the first one if there is none
+    int find(double t) const;
+
+private:
+
+    struct frame {
+        double t;
+        std::int64_t step;
+        std::uint32_t n;
+        const CellRecord *cells;
+    };
+
+    void *mapping;
+    std::size_t mapping_size;
+    std::vector<frame> frames;
+};
+
+#endif //NC_CELL_TRAJECTORY_H
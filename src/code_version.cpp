@@ -0,0 +1,27 @@
+#include "code_version.h"
+
+#include <cstdio>
+
+#if defined(__has_include)
+#if __has_include("nc_code_version.h")
+#include "nc_code_version.h"
+#endif
+#endif
+
+#ifndef NC_CODE_VERSION
+#define NC_CODE_VERSION "unknown"
+#endif
+
+using namespace std;
+
+
+const char *code_version() {
+    return NC_CODE_VERSION;
+}
+
+
+string hex_string(unsigned long long hash) {
+    char s[17];
+    snprintf(s, sizeof(s), "%016llx", hash);
+    return s;
+}
@@ -0,0 +1,35 @@
+/*
+ * Identity of the model code and small hashing helpers, for results that are stored and reused across runs.
+ *
+ * code_version() is a hash of the sources in src/ and of the particle backend, compiler, build type and flags they are
+ * built with, regenerated at every build by cmake/code_version.cmake, so any change to the model or to how it is built
+ * gives another version. Builds without it, e.g. outside CMake, report "unknown".
+ */
+
+#ifndef NC_CODE_VERSION_H
+#define NC_CODE_VERSION_H
+
+#include <cstddef>
+#include <string>
+
+
+const char *code_version();
+
+
+// 64-bit FNV-1a of some bytes, continuing from hash
+inline unsigned long long fnv1a(const void *data, size_t size, unsigned long long hash = 14695981039346656037ull) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+inline unsigned long long fnv1a(const std::string &s, unsigned long long hash = 14695981039346656037ull) {
+    return fnv1a(s.data(), s.size(), hash);
+}
+
+// 16 hexadecimal digits
+std::string hex_string(unsigned long long hash);
+
+#endif //NC_CODE_VERSION_H
@@ -0,0 +1,218 @@
+#include "ensemble_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace Eigen;
+
+
+/*
+ * Welford, merged with the pairwise update of Chan et al.
+ */
+
+void RunningStats::add(double x) {
+    n += 1;
+    const double delta = x - m;
+    m += delta / double(n);
+    m2 += delta * (x - m);
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+}
+
+
+void RunningStats::merge(const RunningStats &other) {
+    if (other.n == 0) {
+        return;
+    }
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+
+    const double total = double(n + other.n);
+    const double delta = other.m - m;
+    m += delta * double(other.n) / total;
+    m2 += other.m2 + delta * delta * double(n) * double(other.n) / total;
+    n += other.n;
+    lo = std::min(lo, other.lo);
+    hi = std::max(hi, other.hi);
+}
+
+
+void RunningField::add(const Ref<const MatrixXd> &x) {
+    if (n == 0) {
+        m = ArrayXXd::Zero(x.rows(), x.cols());
+        m2 = ArrayXXd::Zero(x.rows(), x.cols());
+    } else if (x.rows() != m.rows() || x.cols() != m.cols()) {
+        throw invalid_argument("RunningField: sample shape differs from the first sample");
+    }
+
+    n += 1;
+    const ArrayXXd delta = x.array() - m;
+    m += delta / double(n);
+    m2 += delta * (x.array() - m);
+}
+
+
+void RunningField::merge(const RunningField &other) {
+    if (other.n == 0) {
+        return;
+    }
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+    if (other.m.rows() != m.rows() || other.m.cols() != m.cols()) {
+        throw invalid_argument("RunningField: merged fields differ in shape");
+    }
+
+    const double total = double(n + other.n);
+    const ArrayXXd delta = other.m - m;
+    m += delta * (double(other.n) / total);
+    m2 += other.m2 + delta.square() * (double(n) * double(other.n) / total);
+    n += other.n;
+}
+
+
+ArrayXXd RunningField::variance() const {
+    if (n < 2) {
+        return ArrayXXd::Zero(m.rows(), m.cols());
+    }
+    return m2 / double(n - 1);
+}
+
+
+/*
+ * KLL style sketch
+ */
+
+void QuantileSketch::add(double x) {
+    if (levels.empty()) {
+        levels.resize(1);
+    }
+    levels[0].push_back(x);
+    n += 1;
+    compress();
+}
+
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+    if (levels.size() < other.levels.size()) {
+        levels.resize(other.levels.size());
+    }
+    for (size_t h = 0; h < other.levels.size(); ++h) {
+        levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+    }
+    n += other.n;
+    compress();
+}
+
+
+void QuantileSketch::compress() {
+    for (size_t h = 0; h < levels.size(); ++h) {
+        if (int(levels[h].size()) <= k) {
+            continue;
+        }
+
+        if (h + 1 == levels.size()) {
+            levels.emplace_back();
+        }
+        vector<double> &level = levels[h];
+        vector<double> &above = levels[h + 1];
+
+        sort(level.begin(), level.end());
+
+        // an odd entry out stays on this level
+        double left_over = 0;
+        const bool has_left_over = level.size() % 2 == 1;
+        if (has_left_over) {
+            left_over = level.back();
+            level.pop_back();
+        }
+
+        for (size_t i = odd ? 1 : 0; i < level.size(); i += 2) {
+            above.push_back(level[i]);
+        }
+        odd = !odd;
+
+        level.clear();
+        if (has_left_over) {
+            level.push_back(left_over);
+        }
+    }
+}
+
+
+double QuantileSketch::quantile(double q) const {
+    vector<pair<double, double>> weighted; // value, weight
+    for (size_t h = 0; h < levels.size(); ++h) {
+        for (double x : levels[h]) {
+            weighted.emplace_back(x, std::ldexp(1.0, int(h)));
+        }
+    }
+    if (weighted.empty()) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+
+    sort(weighted.begin(), weighted.end());
+
+    double total = 0;
+    for (const auto &w : weighted) {
+        total += w.second;
+    }
+
+    const double rank = std::min(std::max(q, 0.0), 1.0) * total;
+    double cumulative = 0;
+    for (const auto &w : weighted) {
+        cumulative += w.second;
+        if (cumulative >= rank) {
+            return w.first;
+        }
+    }
+    return weighted.back().first;
+}
+
+
+/*
+ * statistics of one parameter set
+ */
+
+void EnsembleStats::add_result(const VectorXi &density, double pro_break) {
+    density_stats.add(density.cast<double>());
+    break_stats.add(pro_break);
+
+    if (options.quantile_sketch_size > 0) {
+        if (density_quantiles.empty()) {
+            density_quantiles.assign(density.size(), QuantileSketch(options.quantile_sketch_size));
+        }
+        for (int i = 0; i < density.size() && i < int(density_quantiles.size()); ++i) {
+            density_quantiles[i].add(density(i));
+        }
+    }
+}
+
+
+void EnsembleStats::add_chemo(int step, const MatrixXd &chemo) {
+    chemo_stats[step].add(chemo);
+}
+
+
+void EnsembleStats::merge(const EnsembleStats &other) {
+    density_stats.merge(other.density_stats);
+    break_stats.merge(other.break_stats);
+
+    if (density_quantiles.empty()) {
+        density_quantiles = other.density_quantiles;
+    } else {
+        for (size_t i = 0; i < density_quantiles.size() && i < other.density_quantiles.size(); ++i) {
+            density_quantiles[i].merge(other.density_quantiles[i]);
+        }
+    }
+
+    for (const auto &field : other.chemo_stats) {
+        chemo_stats[field.first].merge(field.second);
+    }
+}
@@ -0,0 +1,145 @@
+/*
+ * Online statistics over the seeds of an ensemble, in memory that does not grow with the number of seeds.
+ *
+ * RunningStats and RunningField keep Welford's count, mean and sum of squared deviations, of a scalar and elementwise
+ * of a matrix (a density profile is a one column matrix). QuantileSketch is a small mergeable quantile summary in the
+ * style of KLL: level h holds samples that stand for 2^h of the original ones, and a level that grows past k entries is
+ * sorted and every other entry is promoted to the next level. Its memory is O(k log(n / k)) and the rank error about
+ * n / k.
+ *
+ * Everything has merge(), so threads can accumulate their own part of an ensemble and combine the parts at the end,
+ * with the same result (up to rounding) as accumulating all samples in one place.
+ */
+
+#ifndef NC_ENSEMBLE_STATS_H
+#define NC_ENSEMBLE_STATS_H
+
+#include <Eigen/Core>
+
+#include <limits>
+#include <map>
+#include <vector>
+
+
+class RunningStats {
+public:
+
+    void add(double x);
+
+    void merge(const RunningStats &other);
+
+    long count() const { return n; }
+
+    double mean() const { return m; }
+
+    // sample variance, 0 for fewer than two samples
+    double variance() const { return n > 1 ? m2 / double(n - 1) : 0.0; }
+
+    double min() const { return lo; }
+
+    double max() const { return hi; }
+
+private:
+    long n = 0;
+    double m = 0;
+    double m2 = 0;
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+};
+
+
+class RunningField {
+public:
+
+    // the first sample fixes the shape, later ones must match it (std::invalid_argument otherwise)
+    void add(const Eigen::Ref<const Eigen::MatrixXd> &x);
+
+    void merge(const RunningField &other);
+
+    long count() const { return n; }
+
+    const Eigen::ArrayXXd &mean() const { return m; }
+
+    Eigen::ArrayXXd variance() const;
+
+    Eigen::ArrayXXd sum() const { return m * double(n); }
+
+private:
+    long n = 0;
+    Eigen::ArrayXXd m;
+    Eigen::ArrayXXd m2;
+};
+
+
+class QuantileSketch {
+public:
+
+    explicit QuantileSketch(int k = 200) : k(k) {}
+
+    void add(double x);
+
+    void merge(const QuantileSketch &other);
+
+    long count() const { return n; }
+
+    // value with a proportion q of the samples below it, NaN if empty
+    double quantile(double q) const;
+
+private:
+
+    void compress();
+
+    int k;
+    long n = 0;
+    bool odd = false; // alternates which half of a level survives a compaction
+    std::vector<std::vector<double>> levels;
+};
+
+
+struct EnsembleStatsOptions {
+    int quantile_sketch_size = 0; // size k of the per-bin quantile sketches of the density, 0 for none
+    int chemo_every = 0; // timesteps between chemoattractant snapshots that are averaged, 0 for none
+};
+
+
+/*
+ * statistics of one parameter set: the density of cells along the domain, the break proportion and, optionally,
+ * density quantiles and the chemoattractant field at every chemo_every-th timestep
+ */
+
+class EnsembleStats {
+public:
+
+    explicit EnsembleStats(const EnsembleStatsOptions &options = EnsembleStatsOptions()) : options(options) {}
+
+    const EnsembleStatsOptions &settings() const { return options; }
+
+    // the end of one simulation
+    void add_result(const Eigen::VectorXi &density, double pro_break);
+
+    // the chemoattractant field of one simulation after the given number of timesteps
+    void add_chemo(int step, const Eigen::MatrixXd &chemo);
+
+    void merge(const EnsembleStats &other);
+
+    const RunningField &density() const { return density_stats; }
+
+    const RunningStats &break_proportion() const { return break_stats; }
+
+    bool has_quantiles() const { return !density_quantiles.empty(); }
+
+    // quantile q of the number of cells in one part of the domain
+    double density_quantile(int bin, double q) const { return density_quantiles[bin].quantile(q); }
+
+    // chemoattractant statistics by timestep
+    const std::map<int, RunningField> &chemo() const { return chemo_stats; }
+
+private:
+    EnsembleStatsOptions options;
+    RunningField density_stats;
+    RunningStats break_stats;
+    std::vector<QuantileSketch> density_quantiles;
+    std::map<int, RunningField> chemo_stats;
+};
+
+#endif //NC_ENSEMBLE_STATS_H
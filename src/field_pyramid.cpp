@@ -0,0 +1,42 @@
+#include "field_pyramid.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace Eigen;
+
+
+// the means of consecutive blocks of v
+static VectorXd segment_means(const VectorXd &v, int block) {
+    const Index n = (v.size() + block - 1) / block;
+    VectorXd means(n);
+    for (Index k = 0; k < n; k++) {
+        means(k) = v.segment(k * block, min<Index>(block, v.size() - k * block)).mean();
+    }
+    return means;
+}
+
+
+void block_average(const VectorXd &x, const VectorXd &y, const MatrixXd &u, int block, VectorXd &x_coarse,
+                   VectorXd &y_coarse, MatrixXd &u_coarse) {
+    if (block < 1 || u.rows() != x.size() || u.cols() != y.size()) {
+        throw invalid_argument("block_average: blocks of " + to_string(block) + " on a grid of " +
+                               to_string(u.rows()) + " x " + to_string(u.cols()));
+    }
+
+    x_coarse = segment_means(x, block);
+    y_coarse = segment_means(y, block);
+
+    const Index nx = x_coarse.size();
+    const Index ny = y_coarse.size();
+    u_coarse.resize(nx, ny);
+    for (Index J = 0; J < ny; J++) {
+        const Index cols = min<Index>(block, u.cols() - J * block);
+        for (Index I = 0; I < nx; I++) {
+            const Index rows = min<Index>(block, u.rows() - I * block);
+            u_coarse(I, J) = u.block(I * block, J * block, rows, cols).mean();
+        }
+    }
+}
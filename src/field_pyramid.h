@@ -0,0 +1,19 @@
+/*
+ * Coarse levels of a field on a rectilinear grid, for output that is read at less than full resolution.
+ *
+ * Level k of the pyramid averages blocks of 2^k x 2^k grid points, and the coordinates of a coarse point are the means
+ * of the coordinates in its block. Blocks at the upper edges may be cut short by the grid, they average the points they
+ * hold, so every level covers the whole domain.
+ */
+
+#ifndef NC_FIELD_PYRAMID_H
+#define NC_FIELD_PYRAMID_H
+
+#include <Eigen/Core>
+
+
+// u(i, j) at (x(i), y(j)) averaged over blocks of block x block points
+void block_average(const Eigen::VectorXd &x, const Eigen::VectorXd &y, const Eigen::MatrixXd &u, int block,
+                   Eigen::VectorXd &x_coarse, Eigen::VectorXd &y_coarse, Eigen::MatrixXd &u_coarse);
+
+#endif //NC_FIELD_PYRAMID_H
@@ -0,0 +1,136 @@
+#include "fork_ensemble.h"
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace Eigen;
+
+
+ForkedEnsemble::ForkedEnsemble(const SimulationConfig &config, int base_seed, double branch_time)
+        : simulation(config, base_seed) {
+    while (simulation.time() < branch_time && !simulation.finished()) {
+        simulation.step();
+    }
+    // the children must not wait for saves or a checkpoint of the parent, whose threads they do not have
+    simulation.wait_for_output();
+    simulation.wait_for_checkpoint();
+}
+
+
+vector<BranchResult> ForkedEnsemble::run(const vector<int> &seeds, int processes) {
+
+    const int bins = simulation.configuration().density_bins();
+
+    // one slot per seed: completed, break proportion and the density, written by the child before it exits
+    const size_t slot = size_t(2 + bins);
+    const size_t bytes = max(size_t(1), seeds.size() * slot * sizeof(double));
+    void *shared = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        throw runtime_error(string("cannot map memory for the branch results: ") + strerror(errno));
+    }
+    double *slots = static_cast<double *>(shared);
+    fill(slots, slots + seeds.size() * slot, 0.0);
+
+    // nothing buffered is written twice by the children
+    cout.flush();
+    fflush(nullptr);
+
+    map<pid_t, size_t> running;
+    size_t next = 0;
+
+    auto spawn = [&]() {
+        const size_t k = next++;
+        const pid_t pid = fork();
+        if (pid == 0) {
+            int code = 0;
+            try {
+                // the branches run at the same time, everything they write is their own: snapshots, checkpoints,
+                // trajectories and telemetry
+                simulation.set_output_prefix(simulation.config.output_prefix + "b" + to_string(seeds[k]) + "_");
+                simulation.telemetry_job += "_b" + to_string(seeds[k]);
+                if (simulation.telemetry) {
+                    simulation.config.telemetry = Telemetry::process_path(simulation.config.telemetry,
+                                                                          "b" + to_string(seeds[k]));
+                    simulation.telemetry = Telemetry::open(simulation.config.telemetry);
+                }
+                // the I/O threads of the output queue were not forked, and the live view is the parent's
+                simulation.config.async_output = false;
+                simulation.config.live_view_freq = 0;
+                simulation.reseed(seeds[k]);
+                simulation.run();
+                simulation.wait_for_checkpoint(); // before _exit ends the writing thread
+
+                double *out = slots + k * slot;
+                const VectorXi density = simulation.density_profile();
+                out[1] = simulation.break_proportion();
+                for (int i = 0; i < bins; ++i) {
+                    out[2 + i] = density(i);
+                }
+                out[0] = 1;
+            } catch (const exception &e) {
+                fprintf(stderr, "branch %d: %s\n", seeds[k], e.what());
+                code = 1;
+            }
+            _exit(code);
+        }
+        if (pid < 0) {
+            if (running.empty()) {
+                munmap(shared, bytes);
+                throw runtime_error(string("cannot start a branch: ") + strerror(errno));
+            }
+            next--; // try again once a child has finished
+            return false;
+        }
+        running[pid] = k;
+        return true;
+    };
+
+    processes = max(1, processes);
+    while (int(running.size()) < processes && next < seeds.size() && spawn()) {
+    }
+
+    while (!running.empty()) {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (running.erase(pid) == 0) {
+            continue; // not one of ours
+        }
+        while (int(running.size()) < processes && next < seeds.size() && spawn()) {
+        }
+    }
+
+    vector<BranchResult> results(seeds.size());
+    for (size_t k = 0; k < seeds.size(); ++k) {
+        const double *in = slots + k * slot;
+        results[k].seed = seeds[k];
+        results[k].completed = in[0] == 1;
+        if (results[k].completed) {
+            results[k].break_proportion = in[1];
+            results[k].density.resize(bins);
+            for (int i = 0; i < bins; ++i) {
+                results[k].density(i) = int(in[2 + i]);
+            }
+        }
+    }
+
+    munmap(shared, bytes);
+    return results;
+}
@@ -0,0 +1,53 @@
+/*
+ * An ensemble that shares the start of its runs: one simulation is advanced to a branch time, and then fork() makes one
+ * child process per seed that reseeds it (Simulation::reseed) and carries on to final_time.
+ *
+ * The children start from the parent's memory copy-on-write, so the setup of the grids and the cells, the neighbour
+ * search and the timesteps before the branch are paid for once, and pages a child does not write, e.g. a mapped growth
+ * trajectory, stay shared between all of them. The fields the model updates every timestep are copied by each child on
+ * its first step. It is also an experimental design: all seeds have the same history up to the branch time.
+ *
+ * The children return their density profile and break proportion through shared memory. Every child prefixes the
+ * output files it writes with b<seed>_, checkpoints and the cell trajectory included; the snapshots saved before the
+ * branch stay listed in its .pvd under the names the parent wrote them with. A child reports its telemetry as the
+ * parent's job with _b<seed> appended, to a .prom file of its own (Telemetry::process_path with b<seed>). The children
+ * run the model on one thread each; start them before the process has used threads for anything else, as a forked child
+ * has only the thread that forked it.
+ */
+
+#ifndef NC_FORK_ENSEMBLE_H
+#define NC_FORK_ENSEMBLE_H
+
+#include "simulation.h"
+
+#include <Eigen/Core>
+
+#include <vector>
+
+
+struct BranchResult {
+    int seed = 0;
+    bool completed = false; // false if the child failed or was killed
+    double break_proportion = 0;
+    Eigen::VectorXi density;
+};
+
+
+class ForkedEnsemble {
+public:
+
+    // advances a simulation of config with base_seed until branch_time
+    ForkedEnsemble(const SimulationConfig &config, int base_seed, double branch_time);
+
+    const Simulation &warm() const { return simulation; }
+
+    // forks a child for every seed, at most processes at a time, and waits for them, the results in the order of seeds;
+    // throws std::runtime_error if no child can be started
+    std::vector<BranchResult> run(const std::vector<int> &seeds, int processes);
+
+private:
+
+    Simulation simulation;
+};
+
+#endif //NC_FORK_ENSEMBLE_H
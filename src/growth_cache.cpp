@@ -0,0 +1,170 @@
+#include "growth_cache.h"
+#include "code_version.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+
+namespace {
+
+    const char growth_magic[16] = "nc growth 1";
+
+    // everything the growth depends on, at the start of the file
+    struct growth_header {
+        char magic[16];
+        double n_faster;
+        double thetasmall;
+        double final_length;
+        double final_time;
+        double dt;
+        double dx;
+        int first_part_grows;
+        int length_x;
+        int steps;
+        int unused;
+    };
+
+    growth_header header_of(const SimulationConfig &config) {
+        growth_header header;
+        memset(&header, 0, sizeof(header)); // the padding is hashed and compared too
+        memcpy(header.magic, growth_magic, sizeof(growth_magic));
+        header.n_faster = config.n_faster;
+        header.thetasmall = config.thetasmall;
+        header.final_length = config.final_length;
+        header.final_time = config.final_time;
+        header.dt = config.dt;
+        header.dx = config.dx;
+        header.first_part_grows = config.first_part_grows ? 1 : 0;
+        header.length_x = config.length_x();
+        header.steps = config.number_of_steps();
+        return header;
+    }
+
+    // computes the trajectory as step() would and writes it to path, via a temporary file
+    void write_trajectory(const SimulationConfig &config, const growth_header &header, const string &path) {
+        const string temporary = path + "." + to_string(getpid()) + ".tmp";
+        {
+            ofstream out(temporary, ios::binary);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            const VectorXd strain = strain_rate(config);
+            VectorXd Gamma_x = VectorXd::Zero(header.length_x);
+            VectorXd Gamma = VectorXd::Zero(header.length_x);
+            const streamsize row = streamsize(sizeof(double)) * header.length_x;
+
+            double t = 0.0;
+            for (int n = 1; n <= header.steps; ++n) {
+                t = t + config.dt;
+                growth_at(strain, t, config.dx, Gamma_x, Gamma);
+                out.write(reinterpret_cast<const char *>(Gamma_x.data()), row);
+                out.write(reinterpret_cast<const char *>(Gamma.data()), row);
+            }
+
+            if (!out) {
+                remove(temporary.c_str());
+                throw runtime_error("cannot write the growth trajectory " + temporary);
+            }
+        }
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            throw runtime_error("cannot write the growth trajectory " + path + ": " + strerror(errno));
+        }
+    }
+}
+
+
+shared_ptr<const GrowthTrajectory> GrowthTrajectory::open(const SimulationConfig &config, const string &directory) {
+
+    // the trajectories mapped by this process, one mapping per file however many simulations use it
+    static mutex registry_mutex;
+    static std::map<string, weak_ptr<const GrowthTrajectory>> registry;
+
+    const growth_header header = header_of(config);
+
+    const string path = directory + "/growth_" + hex_string(fnv1a(&header, sizeof(header))) + ".bin";
+
+    lock_guard<mutex> lock(registry_mutex);
+
+    shared_ptr<const GrowthTrajectory> trajectory = registry[path].lock();
+    if (trajectory) {
+        return trajectory;
+    }
+
+    shared_ptr<GrowthTrajectory> mapped(new GrowthTrajectory(path));
+    if (!mapped->map(&header, sizeof(header), header.length_x, header.steps)) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw runtime_error("cannot create " + directory + ": " + strerror(errno));
+        }
+        write_trajectory(config, header, path);
+        if (!mapped->map(&header, sizeof(header), header.length_x, header.steps)) {
+            throw runtime_error("cannot map the growth trajectory " + path);
+        }
+    }
+
+    registry[path] = mapped;
+    return mapped;
+}
+
+
+GrowthTrajectory::GrowthTrajectory(const string &path)
+        : file(path), mapping(nullptr), mapping_size(0), rows(nullptr), length_x(0), n_steps(0) {}
+
+
+GrowthTrajectory::~GrowthTrajectory() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+
+bool GrowthTrajectory::map(const void *header, size_t header_size, int length_x, int steps) {
+    const size_t size = header_size + 2 * sizeof(double) * size_t(length_x) * size_t(steps);
+
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) == size) {
+        p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    if (memcmp(p, header, header_size) != 0) {
+        munmap(p, size);
+        return false;
+    }
+
+    mapping = p;
+    mapping_size = size;
+    rows = reinterpret_cast<const double *>(static_cast<const char *>(p) + header_size);
+    this->length_x = length_x;
+    n_steps = steps;
+    return true;
+}
+
+
+void GrowthTrajectory::load(int step, VectorXd &Gamma_x, VectorXd &Gamma) const {
+    const double *row = rows + 2 * size_t(length_x) * size_t(step - 1);
+    Gamma_x = Map<const VectorXd>(row, length_x);
+    Gamma = Map<const VectorXd>(row + length_x, length_x);
+}
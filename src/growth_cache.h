@@ -0,0 +1,66 @@
+/*
+ * Growth trajectories shared between simulations and processes.
+ *
+ * The growth of the domain, Gamma_x and Gamma at every timestep, depends only on first_part_grows, n_faster, thetasmall,
+ * final_length, final_time, dt, dx and the grid size, not on the seed or the cells. GrowthTrajectory::open() computes
+ * it once for all timesteps into a file in a cache directory, named by a hash of those parameters, and maps the file
+ * read-only. Simulations of the same process share one mapping, other processes map the same file, and a timestep's
+ * growth becomes a copy of two rows of the table.
+ *
+ * The file is written to a temporary name and renamed into place, so processes racing to create it both write the same
+ * contents and readers never see a partial file. A file whose header does not match the parameters, e.g. after a hash
+ * collision or from an older version, is replaced. The values are bitwise those of growth_at() at the times step()
+ * reaches.
+ */
+
+#ifndef NC_GROWTH_CACHE_H
+#define NC_GROWTH_CACHE_H
+
+#include "simulation.h"
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+class GrowthTrajectory {
+public:
+
+    // the trajectory of config from directory, computed and written there first if missing, throws
+    // std::runtime_error if the directory or the file cannot be written
+    static std::shared_ptr<const GrowthTrajectory> open(const SimulationConfig &config, const std::string &directory);
+
+    ~GrowthTrajectory();
+
+    GrowthTrajectory(const GrowthTrajectory &) = delete;
+
+    GrowthTrajectory &operator=(const GrowthTrajectory &) = delete;
+
+    // the table has timesteps 1 to steps(), step 0 is the initial grid
+    bool covers(int step) const { return step >= 1 && step <= n_steps; }
+
+    int steps() const { return n_steps; }
+
+    const std::string &path() const { return file; }
+
+    // Gamma_x and Gamma after the given timestep
+    void load(int step, Eigen::VectorXd &Gamma_x, Eigen::VectorXd &Gamma) const;
+
+private:
+
+    explicit GrowthTrajectory(const std::string &path);
+
+    // maps the file if it holds the trajectory described by header, false otherwise
+    bool map(const void *header, size_t header_size, int length_x, int steps);
+
+    std::string file;
+    void *mapping;
+    size_t mapping_size;
+    const double *rows; // Gamma_x then Gamma of every timestep, length_x each
+    int length_x;
+    int n_steps;
+};
+
+#endif //NC_GROWTH_CACHE_H
@@ -0,0 +1,198 @@
+#include "live_view.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+
+static const char live_view_magic[16] = "nc live view";
+static const uint32_t live_view_version = 1;
+
+
+static uint64_t aligned(uint64_t bytes) {
+    return (bytes + 63) / 64 * 64;
+}
+
+
+static LiveFrameHeader *frame_at(void *mapping, uint64_t offset) {
+    return reinterpret_cast<LiveFrameHeader *>(static_cast<char *>(mapping) + offset);
+}
+
+
+/*
+ * publisher
+ */
+
+LiveViewPublisher::LiveViewPublisher(const string &name, int length_x, int length_y, int max_cells)
+        : name(name), mapping(nullptr), mapping_size(0), header(nullptr) {
+    const uint64_t gamma_offset = aligned(sizeof(LiveFrameHeader));
+    const uint64_t chemo_offset = gamma_offset + aligned(uint64_t(length_x) * sizeof(double));
+    const uint64_t cells_offset = chemo_offset + aligned(uint64_t(length_x) * length_y * sizeof(double));
+    const uint64_t frame_size = cells_offset + aligned(uint64_t(max_cells) * sizeof(LiveCell));
+    const uint64_t first_frame = aligned(sizeof(LiveViewHeader));
+    mapping_size = size_t(first_frame + 2 * frame_size);
+
+    // a new segment, readers of an old one keep theirs
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        throw runtime_error("cannot create the live view " + name + ": " + strerror(errno));
+    }
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, off_t(mapping_size)) == 0) {
+        p = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int error = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw runtime_error("cannot create the live view " + name + ": " + strerror(error));
+    }
+    mapping = p;
+
+    // the segment is zero filled, every frame unpublished
+    header = new(mapping) LiveViewHeader;
+    memcpy(header->magic, live_view_magic, sizeof(header->magic));
+    header->version = live_view_version;
+    header->length_x = uint32_t(length_x);
+    header->length_y = uint32_t(length_y);
+    header->max_cells = uint32_t(max_cells);
+    header->frame_size = frame_size;
+    header->pid = uint32_t(getpid());
+    for (int k = 0; k < 2; ++k) {
+        header->frame_offset[k] = first_frame + k * frame_size;
+        LiveFrameHeader *frame = new(frame_at(mapping, header->frame_offset[k])) LiveFrameHeader;
+        frame->sequence.store(0, memory_order_relaxed);
+        frame->gamma_offset = gamma_offset;
+        frame->chemo_offset = chemo_offset;
+        frame->cells_offset = cells_offset;
+    }
+    header->latest.store(0, memory_order_release);
+}
+
+
+LiveViewPublisher::~LiveViewPublisher() {
+    munmap(mapping, mapping_size);
+    shm_unlink(name.c_str());
+}
+
+
+LiveFrameHeader *LiveViewPublisher::next_frame() const {
+    return frame_at(mapping, header->frame_offset[1 - header->latest.load(memory_order_relaxed)]);
+}
+
+
+double *LiveViewPublisher::gamma() {
+    LiveFrameHeader *frame = next_frame();
+    return reinterpret_cast<double *>(reinterpret_cast<char *>(frame) + frame->gamma_offset);
+}
+
+
+double *LiveViewPublisher::chemo() {
+    LiveFrameHeader *frame = next_frame();
+    return reinterpret_cast<double *>(reinterpret_cast<char *>(frame) + frame->chemo_offset);
+}
+
+
+LiveCell *LiveViewPublisher::cells() {
+    LiveFrameHeader *frame = next_frame();
+    return reinterpret_cast<LiveCell *>(reinterpret_cast<char *>(frame) + frame->cells_offset);
+}
+
+
+void LiveViewPublisher::begin() {
+    // readers still on this frame see the sequence change
+    LiveFrameHeader *frame = next_frame();
+    frame->sequence.store(frame->sequence.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+
+void LiveViewPublisher::publish(const LiveSummary &summary, int shown_cells) {
+    const uint32_t next = 1 - header->latest.load(memory_order_relaxed);
+    LiveFrameHeader *frame = frame_at(mapping, header->frame_offset[next]);
+
+    frame->t = summary.t;
+    frame->step = summary.step;
+    frame->cells = uint32_t(summary.cells);
+    frame->leaders = uint32_t(summary.leaders);
+    frame->in_chains = uint32_t(summary.in_chains);
+    frame->shown_cells = uint32_t(shown_cells);
+    frame->front = summary.front;
+
+    frame->sequence.store(frame->sequence.load(memory_order_relaxed) + 1, memory_order_release);
+    header->latest.store(next, memory_order_release);
+}
+
+
+/*
+ * reader
+ */
+
+LiveView::LiveView(const string &name) : mapping(nullptr), mapping_size(0), header(nullptr) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        throw runtime_error("cannot open the live view " + name + ": " + strerror(errno));
+    }
+    struct stat info;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(LiveViewHeader)) {
+        p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw runtime_error(name + " is not a live view");
+    }
+    mapping = p;
+    mapping_size = size_t(info.st_size);
+    header = static_cast<const LiveViewHeader *>(mapping);
+
+    if (memcmp(header->magic, live_view_magic, sizeof(header->magic)) != 0 || header->version != live_view_version ||
+        header->frame_offset[1] + header->frame_size > mapping_size) {
+        munmap(mapping, mapping_size);
+        throw runtime_error(name + " is not a live view");
+    }
+}
+
+
+LiveView::~LiveView() {
+    munmap(mapping, mapping_size);
+}
+
+
+bool LiveView::begin_read(LiveFrame &frame) const {
+    frame.index = int(header->latest.load(memory_order_acquire));
+    const char *base = static_cast<const char *>(mapping) + header->frame_offset[frame.index];
+    const LiveFrameHeader *f = reinterpret_cast<const LiveFrameHeader *>(base);
+
+    frame.sequence = f->sequence.load(memory_order_acquire);
+    if (frame.sequence == 0 || frame.sequence % 2 == 1) {
+        return false;
+    }
+    frame.summary.t = f->t;
+    frame.summary.step = int(f->step);
+    frame.summary.cells = int(f->cells);
+    frame.summary.leaders = int(f->leaders);
+    frame.summary.in_chains = int(f->in_chains);
+    frame.summary.front = f->front;
+    frame.shown_cells = int(f->shown_cells);
+    frame.gamma = reinterpret_cast<const double *>(base + f->gamma_offset);
+    frame.chemo = reinterpret_cast<const double *>(base + f->chemo_offset);
+    frame.cells = reinterpret_cast<const LiveCell *>(base + f->cells_offset);
+    return true;
+}
+
+
+bool LiveView::end_read(const LiveFrame &frame) const {
+    atomic_thread_fence(memory_order_acquire);
+    const LiveFrameHeader *f = reinterpret_cast<const LiveFrameHeader *>(static_cast<const char *>(mapping) +
+                                                                         header->frame_offset[frame.index]);
+    return f->sequence.load(memory_order_relaxed) == frame.sequence;
+}
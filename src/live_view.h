@@ -0,0 +1,171 @@
+/*
+ * The state of a running simulation in POSIX shared memory, for viewers on the same machine.
+ *
+ * The segment (shm_open name, /dev/shm/<name> on Linux) holds a LiveViewHeader and two frames. Each frame is a
+ * LiveFrameHeader, Gamma (length_x doubles), the chemoattractant (length_x * length_y doubles, x fastest) and up to
+ * max_cells LiveCells, at the offsets in the header. The publisher writes the frame that is not the latest one and
+ * then makes it the latest, so readers of the latest frame are only disturbed if two frames are published while they
+ * read. Every frame is a seqlock: its sequence is odd while it is written and grows by two with every publication, a
+ * reader that sees the same even sequence before and after reading has read a consistent frame.
+ *
+ * Readers map the segment read-only and read the frames in place, the publisher never waits for them. The publisher
+ * removes the name when it is destroyed, attached readers keep their mapping.
+ */
+
+#ifndef NC_LIVE_VIEW_H
+#define NC_LIVE_VIEW_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+struct LiveViewHeader {
+    char magic[16]; // "nc live view"
+    std::uint32_t version;
+    std::uint32_t length_x;
+    std::uint32_t length_y;
+    std::uint32_t max_cells;
+    std::uint64_t frame_offset[2];
+    std::uint64_t frame_size;
+    std::atomic<std::uint32_t> latest; // the frame published last
+    std::uint32_t pid; // of the publisher
+};
+
+struct LiveFrameHeader {
+    std::atomic<std::uint64_t> sequence; // 0 never published, odd while being written
+    double t;
+    std::int64_t step;
+    std::uint32_t cells;
+    std::uint32_t leaders;
+    std::uint32_t in_chains; // followers in a chain
+    std::uint32_t shown_cells; // cells in the frame, at most max_cells
+    double front; // position of the foremost cell
+    std::uint64_t gamma_offset; // from the start of the frame
+    std::uint64_t chemo_offset;
+    std::uint64_t cells_offset;
+};
+
+struct LiveCell {
+    float x;
+    float y;
+    std::int32_t type; // 0 leader, 1 follower
+    std::int32_t chain; // place in its chain, 1 behind the leader, 0 if in none
+};
+
+
+// what a publication holds besides the grids
+struct LiveSummary {
+    double t = 0;
+    int step = 0;
+    int cells = 0;
+    int leaders = 0;
+    int in_chains = 0;
+    double front = 0;
+};
+
+
+class LiveViewPublisher {
+public:
+
+    // creates the segment, replacing one of the same name, throws std::runtime_error if it cannot
+    LiveViewPublisher(const std::string &name, int length_x, int length_y, int max_cells);
+
+    ~LiveViewPublisher();
+
+    LiveViewPublisher(const LiveViewPublisher &) = delete;
+
+    LiveViewPublisher &operator=(const LiveViewPublisher &) = delete;
+
+    // a publication: begin() takes the frame that is not the latest, gamma(), chemo() and cells() are filled in place,
+    // and publish() makes it the latest
+    void begin();
+
+    double *gamma();
+
+    double *chemo();
+
+    LiveCell *cells();
+
+    int max_cells() const { return int(header->max_cells); }
+
+    void publish(const LiveSummary &summary, int shown_cells);
+
+private:
+
+    LiveFrameHeader *next_frame() const;
+
+    std::string name;
+    void *mapping;
+    std::size_t mapping_size;
+    LiveViewHeader *header;
+};
+
+
+// a consistent frame, in the segment
+struct LiveFrame {
+    int index; // of the frame in the segment
+    std::uint64_t sequence;
+    LiveSummary summary;
+    int shown_cells;
+    const double *gamma;
+    const double *chemo;
+    const LiveCell *cells;
+};
+
+
+class LiveView {
+public:
+
+    // maps the segment read-only, throws std::runtime_error if there is none of that name
+    explicit LiveView(const std::string &name);
+
+    ~LiveView();
+
+    LiveView(const LiveView &) = delete;
+
+    LiveView &operator=(const LiveView &) = delete;
+
+    int length_x() const { return int(header->length_x); }
+
+    int length_y() const { return int(header->length_y); }
+
+    // calls read(const LiveFrame &) on the latest frame in place, again if it was overwritten while being read, false
+    // if nothing was published yet
+    template<typename F>
+    bool read(F read) const;
+
+private:
+
+    // the latest frame, false if it is being written or was never published
+    bool begin_read(LiveFrame &frame) const;
+
+    // whether the frame was not written to meanwhile
+    bool end_read(const LiveFrame &frame) const;
+
+    void *mapping;
+    std::size_t mapping_size;
+    const LiveViewHeader *header;
+};
+
+
+template<typename F>
+bool LiveView::read(F read) const {
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        LiveFrame frame;
+        if (!begin_read(frame)) {
+            if (frame.sequence == 0) {
+                return false;
+            }
+            continue;
+        }
+        read(static_cast<const LiveFrame &>(frame));
+        if (end_read(frame)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif //NC_LIVE_VIEW_H
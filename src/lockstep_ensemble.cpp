@@ -0,0 +1,259 @@
+#include "lockstep_ensemble.h"
+#include "growth_cache.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace Eigen;
+
+
+LockstepEnsemble::LockstepEnsemble(const SimulationConfig &config, const vector<int> &seeds)
+        : config(config),
+          n_members(int(seeds.size())),
+          n_threads(1),
+          length_x(config.length_x()),
+          length_y(config.length_y()) {
+
+    if (seeds.empty()) {
+        throw invalid_argument("LockstepEnsemble: no seeds");
+    }
+
+    for (int seed : seeds) {
+        SimulationConfig member_config = config;
+
+        // keep the snapshots, checkpoints and live views of different seeds apart
+        if (seeds.size() > 1) {
+            member_config.output_prefix += "s" + to_string(seed) + "_";
+            if (!member_config.live_view.empty()) {
+                member_config.live_view += "_s" + to_string(seed);
+            }
+        }
+
+        members.emplace_back(new Simulation(member_config, seed));
+
+        // replaced by the shared fields
+        members.back()->chemo_new.resize(0, 0);
+        members.back()->intern.resize(0, 0);
+    }
+
+    strain = strain_rate(config);
+    Gamma_x = members[0]->Gamma_x;
+    Gamma = members[0]->Gamma;
+
+    const size_t n = size_t(length_x) * length_y * n_members;
+    chemo = VectorXd::Ones(n);
+    chemo_new = VectorXd::Ones(n);
+    intern = VectorXd::Zero(n);
+
+    positions.resize(n_members);
+
+    share_chemo();
+}
+
+
+void LockstepEnsemble::run() {
+    while (!finished()) {
+        step();
+    }
+    for (int k = 0; k < n_members; ++k) {
+        members[k]->wait_for_output();
+    }
+}
+
+
+void LockstepEnsemble::step() {
+
+    // as Simulation::step(), with the grid phases done once for all members, whose wall time is shared out among them
+    auto mark = chrono::steady_clock::now();
+    auto lap = [&](Simulation &member, TelemetryPhase phase) {
+        const auto now = chrono::steady_clock::now();
+        member.phase_time[phase] += chrono::duration<double>(now - mark).count();
+        mark = now;
+    };
+    auto lap_all = [&](TelemetryPhase phase) {
+        const auto now = chrono::steady_clock::now();
+        for (auto &member : members) {
+            member->phase_time[phase] += chrono::duration<double>(now - mark).count() / n_members;
+        }
+        mark = now;
+    };
+
+    for (auto &member : members) {
+        member->insert_cells();
+        member->t = member->t + config.dt;
+        member->counter = member->counter + 1;
+        lap(*member, phase_insert);
+    }
+
+    const Simulation &first = *members[0];
+    if (first.growth && first.growth->covers(first.counter)) {
+        first.growth->load(first.counter, Gamma_x, Gamma);
+    } else {
+        growth_at(strain, first.t, config.dx, Gamma_x, Gamma);
+    }
+
+    for (auto &member : members) {
+        member->Gamma_x = Gamma_x;
+        member->Gamma = Gamma;
+        member->move_with_domain();
+    }
+    lap_all(phase_growth);
+
+    internalise();
+
+    solve_chemo();
+
+    share_chemo();
+    lap_all(phase_chemo);
+
+    for (auto &member : members) {
+        member->move_cells();
+        lap(*member, phase_cells);
+    }
+
+    // the outputs of Simulation::step(), which read the member's own fields
+    for (int k = 0; k < n_members; ++k) {
+        Simulation &member = *members[k];
+        const bool save = member.save_due();
+        const bool checkpoint = member.checkpoint_due();
+        const bool live_view = member.live_view_due();
+        if (save || checkpoint || live_view) {
+            member.chemo = chemo_field(k);
+        }
+        if (save) {
+            member.save();
+        }
+        if (checkpoint) {
+            member.intern = lane(intern, k);
+            member.checkpoint_in_background(); // the state is copied before it returns
+            member.intern.resize(0, 0);
+        }
+        if (live_view) {
+            member.publish_live_view();
+        }
+        lap(member, phase_output);
+
+        if (member.telemetry) {
+            member.report_progress(mark);
+        }
+    }
+}
+
+
+void LockstepEnsemble::internalise() {
+
+    const double cell_radius = config.cell_radius;
+
+    for (int k = 0; k < n_members; ++k) {
+        const particle_type &particles = members[k]->particles;
+        positions[k].resize(2 * particles.size());
+        for (size_t p = 0; p < particles.size(); ++p) {
+            positions[k][2 * p] = particles.position(p)[0];
+            positions[k][2 * p + 1] = particles.position(p)[1];
+        }
+    }
+
+    // the same sums in the same order as Simulation::update_chemo(), for every seed
+#pragma omp parallel for num_threads(n_threads) if(n_threads > 1) schedule(static)
+    for (int i = 0; i < length_x; i++) {
+        for (int j = 0; j < length_y; j++) {
+            for (int k = 0; k < n_members; k++) {
+                const vector<double> &x = positions[k];
+                double sum = intern(at(i, j) + k);
+                for (size_t p = 0; p < x.size(); p += 2) {
+                    sum = sum + exp(-((Gamma(i) - x[p]) * (Gamma(i) - x[p]) + (j - x[p + 1]) * (j - x[p + 1])) /
+                                    (2 * cell_radius * cell_radius));
+                }
+                intern(at(i, j) + k) = sum;
+            }
+        }
+    }
+}
+
+
+void LockstepEnsemble::solve_chemo() {
+
+    const double cell_radius = config.cell_radius;
+    const double D = config.D;
+    const double dt = config.dt;
+    const double dx = config.dx;
+    const double dy = config.dy;
+    const double k_reac = config.k_reac;
+    const double lam = config.lam;
+    const int K = n_members;
+
+    // inner coefficients, the geometry once per column and the seeds innermost
+#pragma omp parallel for num_threads(n_threads) if(n_threads > 1) schedule(static)
+    for (int i = 1; i < length_x - 1; ++i) {
+
+        const double a = D * 1.0 / (2.0 * dx * dx * Gamma_x(i));
+        const double b_plus = 1.0 / Gamma_x(i) + 1.0 / Gamma_x(i + 1);
+        const double b_minus = 1.0 / Gamma_x(i) + 1.0 / Gamma_x(i - 1);
+        const double s = strain(i);
+
+        for (int j = 1; j < length_y - 1; ++j) {
+            const double *c = chemo.data() + at(i, j);
+            const double *c_right = chemo.data() + at(i + 1, j);
+            const double *c_left = chemo.data() + at(i - 1, j);
+            const double *c_up = c + K;
+            const double *c_down = c - K;
+            const double *u = intern.data() + at(i, j);
+            double *c_new = chemo_new.data() + at(i, j);
+
+#pragma omp simd
+            for (int k = 0; k < K; ++k) {
+                c_new[k] = dt * (a * (b_plus * (c_right[k] - c[k]) - (c[k] - c_left[k]) * b_minus) +
+                                 D * (c_up[k] - 2 * c[k] + c_down[k]) / (dy * dy) -
+                                 (c[k] * lam / (2 * M_PI * cell_radius * cell_radius)) * u[k] +
+                                 c[k] * k_reac * (1 - c[k]) - s * c[k]) +
+                           c[k];
+            }
+        }
+    }
+
+    // boundaries
+    for (int j = 0; j < length_y; j++) {
+        for (int k = 0; k < K; ++k) {
+            chemo_new(at(0, j) + k) = chemo_new(at(1, j) + k);
+            chemo_new(at(length_x - 1, j) + k) = chemo_new(at(length_x - 2, j) + k);
+        }
+    }
+
+    for (int i = 0; i < length_x; i++) {
+        for (int k = 0; k < K; ++k) {
+            chemo_new(at(i, 0) + k) = chemo_new(at(i, 1) + k);
+            chemo_new(at(i, length_y - 1) + k) = chemo_new(at(i, length_y - 2) + k);
+        }
+    }
+
+    // every value of chemo_new was written, so the old field can take its place next time
+    chemo.swap(chemo_new);
+}
+
+
+void LockstepEnsemble::share_chemo() {
+    for (int k = 0; k < n_members; ++k) {
+        members[k]->chemo_view = chemo.data() + k;
+        members[k]->chemo_stride_x = long(length_y) * n_members;
+        members[k]->chemo_stride_y = n_members;
+    }
+}
+
+
+MatrixXd LockstepEnsemble::chemo_field(int k) const {
+    return lane(chemo, k);
+}
+
+
+MatrixXd LockstepEnsemble::lane(const VectorXd &field, int k) const {
+    MatrixXd lane(length_x, length_y);
+    for (int i = 0; i < length_x; ++i) {
+        for (int j = 0; j < length_y; ++j) {
+            lane(i, j) = field(at(i, j) + k);
+        }
+    }
+    return lane;
+}
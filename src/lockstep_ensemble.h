@@ -0,0 +1,92 @@
+/*
+ * K simulations of the same configuration with different seeds, advanced in lockstep.
+ *
+ * The seeds share the grid and its growth, so Gamma and Gamma_x are computed once per timestep for all of them. The
+ * chemoattractant and internalisation fields of all seeds are stored interleaved, seed innermost,
+ *
+ *     chemo[(i * length_y + j) * K + k]
+ *
+ * so that the reaction-diffusion update is one stencil over the grid whose inner loop runs over the seeds with the same
+ * coefficients, vectorised. The cells of each seed still enter, move with the domain and move with the rules of
+ * Simulation, reading their seed's lane of the shared field.
+ *
+ * Every seed gives bitwise the same results as Simulation(config, seed) stepped on its own, and saves, checkpoints,
+ * publishes its live view and reports its telemetry as that simulation would; with more than one seed the output
+ * prefix and the live view name get s<seed>. member(k).chemo_field() is only up to date on the timesteps a member
+ * wrote something, chemo_field(k) always is.
+ *
+ * It is not faster in an optimised build (bench/lockstep_benchmark): the internalisation, summed over the cells of each
+ * seed at every grid point, costs far more than the shared growth and stencil save, and the cells differ per seed.
+ */
+
+#ifndef NC_LOCKSTEP_ENSEMBLE_H
+#define NC_LOCKSTEP_ENSEMBLE_H
+
+#include "simulation.h"
+
+#include <Eigen/Core>
+
+#include <memory>
+#include <vector>
+
+
+class LockstepEnsemble {
+public:
+
+    LockstepEnsemble(const SimulationConfig &config, const std::vector<int> &seeds);
+
+    int size() const { return n_members; }
+
+    void step();
+
+    void run();
+
+    bool finished() const { return members[0]->finished(); }
+
+    double time() const { return members[0]->time(); }
+
+    int step_count() const { return members[0]->step_count(); }
+
+    // threads for the internalisation and the stencil
+    void set_threads(int n) { n_threads = n > 0 ? n : 1; }
+
+    // the simulation of the k-th seed, for the cells and the density profile
+    const Simulation &member(int k) const { return *members[k]; }
+
+    // the chemoattractant field of the k-th seed
+    Eigen::MatrixXd chemo_field(int k) const;
+
+private:
+
+    size_t at(int i, int j) const { return (size_t(i) * length_y + j) * n_members; }
+
+    // the k-th seed's field of an interleaved one
+    Eigen::MatrixXd lane(const Eigen::VectorXd &field, int k) const;
+
+    void internalise();
+
+    void solve_chemo();
+
+    // the members read their lane of chemo
+    void share_chemo();
+
+    SimulationConfig config;
+    int n_members;
+    int n_threads;
+    int length_x;
+    int length_y;
+
+    std::vector<std::unique_ptr<Simulation>> members;
+
+    Eigen::VectorXd strain;
+    Eigen::VectorXd Gamma_x;
+    Eigen::VectorXd Gamma;
+
+    Eigen::VectorXd chemo;
+    Eigen::VectorXd chemo_new;
+    Eigen::VectorXd intern;
+
+    std::vector<std::vector<double>> positions; // x and y of the cells of every member, for the internalisation
+};
+
+#endif //NC_LOCKSTEP_ENSEMBLE_H
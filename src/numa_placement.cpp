@@ -0,0 +1,126 @@
+#include "numa_placement.h"
+
+#ifdef HAVE_NUMA
+
+#include <numa.h>
+#include <numaif.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+
+static const uintptr_t huge_page_size = uintptr_t(2) << 20;
+
+
+// the whole pages of [data, data + bytes)
+static bool page_range(const void *data, size_t bytes, uintptr_t &begin, uintptr_t &end) {
+    const uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+    begin = (uintptr_t(data) + page - 1) / page * page;
+    end = (uintptr_t(data) + bytes) / page * page;
+    return begin < end;
+}
+
+
+bool numa_placement_available() {
+    return numa_available() >= 0;
+}
+
+
+int numa_placement_nodes() {
+    return numa_placement_available() ? numa_num_configured_nodes() : 1;
+}
+
+
+bool pin_to_numa_node(int node) {
+    if (!numa_placement_available()) {
+        return false;
+    }
+    return numa_run_on_node(node) == 0;
+}
+
+
+void bind_to_numa_node(const void *data, size_t bytes, int node, bool huge_pages) {
+    uintptr_t begin, end;
+    if (!numa_placement_available() || !page_range(data, bytes, begin, end)) {
+        return;
+    }
+
+    if (huge_pages) {
+        const uintptr_t huge_begin = (begin + huge_page_size - 1) / huge_page_size * huge_page_size;
+        const uintptr_t huge_end = end / huge_page_size * huge_page_size;
+        if (huge_begin < huge_end) {
+            madvise(reinterpret_cast<void *>(huge_begin), huge_end - huge_begin, MADV_HUGEPAGE);
+        }
+    }
+
+    // preferred rather than bound, so that a full node spills over instead of failing
+    struct bitmask *nodes = numa_allocate_nodemask();
+    numa_bitmask_setbit(nodes, unsigned(node));
+    mbind(reinterpret_cast<void *>(begin), end - begin, MPOL_PREFERRED, nodes->maskp, nodes->size + 1,
+          MPOL_MF_MOVE);
+    numa_bitmask_free(nodes);
+}
+
+
+NumaPageCount count_numa_pages(const void *data, size_t bytes, int node) {
+    NumaPageCount count;
+    uintptr_t begin, end;
+    if (!numa_placement_available() || !page_range(data, bytes, begin, end)) {
+        return count;
+    }
+
+    const uintptr_t page = uintptr_t(sysconf(_SC_PAGESIZE));
+    vector<void *> pages;
+    for (uintptr_t p = begin; p < end; p += page) {
+        pages.push_back(reinterpret_cast<void *>(p));
+    }
+    vector<int> status(pages.size(), -1);
+
+    // with no target nodes, move_pages only reports where each page is
+    if (numa_move_pages(0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0) {
+        count.unmapped = long(pages.size());
+        return count;
+    }
+
+    for (int s : status) {
+        if (s < 0) {
+            count.unmapped += 1;
+        } else if (s == node) {
+            count.local += 1;
+        } else {
+            count.remote += 1;
+        }
+    }
+    return count;
+}
+
+#else
+
+bool numa_placement_available() {
+    return false;
+}
+
+
+int numa_placement_nodes() {
+    return 1;
+}
+
+
+bool pin_to_numa_node(int) {
+    return false;
+}
+
+
+void bind_to_numa_node(const void *, std::size_t, int, bool) {
+}
+
+
+NumaPageCount count_numa_pages(const void *, std::size_t, int) {
+    return NumaPageCount();
+}
+
+#endif
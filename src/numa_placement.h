@@ -0,0 +1,56 @@
+/*
+ * NUMA placement of simulations, built on libnuma when it was found (HAVE_NUMA), otherwise everything is a no-op on a
+ * single node.
+ *
+ * A thread pinned to a node runs there, and so do the OpenMP threads it starts afterwards, and memory it touches first
+ * is allocated there. bind_to_numa_node() moves memory that was already touched and asks for transparent huge pages on
+ * the part of it that is aligned to them. count_numa_pages() tells how many pages of a block are on a given node and
+ * how many are elsewhere.
+ */
+
+#ifndef NC_NUMA_PLACEMENT_H
+#define NC_NUMA_PLACEMENT_H
+
+#include <cstddef>
+
+
+struct NumaOptions {
+    bool pin = false; // run each simulation on one node, with its fields there
+    bool huge_pages = false; // ask for transparent huge pages for the fields
+};
+
+
+// pages of some memory on the node it should be on and elsewhere
+struct NumaPageCount {
+    long local = 0;
+    long remote = 0;
+    long unmapped = 0; // not touched yet, or the query failed
+
+    NumaPageCount &operator+=(const NumaPageCount &other) {
+        local += other.local;
+        remote += other.remote;
+        unmapped += other.unmapped;
+        return *this;
+    }
+
+    // proportion of the mapped pages that are local, 1 if there are none
+    double local_share() const { return local + remote > 0 ? double(local) / double(local + remote) : 1.0; }
+};
+
+
+// whether the machine has NUMA support and the placement is built in
+bool numa_placement_available();
+
+// number of nodes, 1 without NUMA support
+int numa_placement_nodes();
+
+// runs the calling thread on the cpus of one node only, or on all of them for node -1
+bool pin_to_numa_node(int node);
+
+// moves the pages of [data, data + bytes) to the node, and optionally advises huge pages for them
+void bind_to_numa_node(const void *data, std::size_t bytes, int node, bool huge_pages);
+
+// where the pages of [data, data + bytes) are, relative to the node
+NumaPageCount count_numa_pages(const void *data, std::size_t bytes, int node);
+
+#endif //NC_NUMA_PLACEMENT_H
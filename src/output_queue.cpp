@@ -0,0 +1,160 @@
+#include "output_queue.h"
+
+#include <chrono>
+#include <exception>
+#include <utility>
+
+using namespace std;
+
+
+OutputQueue::OutputQueue(int capacity, int n_threads)
+        : push_position(0), pop_position(0), queued(0), in_flight(0), sleeping(0), stopping(false), n_written(0),
+          n_dropped(0) {
+    size_t size = 1;
+    while (size < size_t(max(capacity, 1))) {
+        size *= 2;
+    }
+    mask = size - 1;
+    slots.reset(new slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    for (int i = 0; i < max(n_threads, 1); ++i) {
+        threads.emplace_back([this]() { work(); });
+    }
+}
+
+
+OutputQueue::~OutputQueue() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread &t : threads) {
+        t.join();
+    }
+}
+
+
+OutputQueue &OutputQueue::shared() {
+    static OutputQueue queue(64, 2);
+    return queue;
+}
+
+
+/*
+ * the ring: slot i is free for the push at position p when its sequence is p, and holds a job for the pop at position
+ * p when it is p + 1; a pop hands the slot on to the push one lap later
+ */
+
+bool OutputQueue::try_push(job_type &job) {
+    size_t position = push_position.load(memory_order_relaxed);
+    for (;;) {
+        slot &s = slots[position & mask];
+        const size_t sequence = s.sequence.load(memory_order_acquire);
+        const ptrdiff_t lag = ptrdiff_t(sequence) - ptrdiff_t(position);
+        if (lag == 0) {
+            if (push_position.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                s.job = move(job);
+                s.sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            return false; // full
+        } else {
+            position = push_position.load(memory_order_relaxed);
+        }
+    }
+}
+
+
+bool OutputQueue::try_pop(job_type &job) {
+    size_t position = pop_position.load(memory_order_relaxed);
+    for (;;) {
+        slot &s = slots[position & mask];
+        const size_t sequence = s.sequence.load(memory_order_acquire);
+        const ptrdiff_t lag = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+        if (lag == 0) {
+            if (pop_position.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                job = move(s.job);
+                s.job = nullptr;
+                s.sequence.store(position + mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            return false; // empty
+        } else {
+            position = pop_position.load(memory_order_relaxed);
+        }
+    }
+}
+
+
+bool OutputQueue::push(job_type job, Backpressure backpressure) {
+    in_flight++;
+    while (!try_push(job)) {
+        if (backpressure == Backpressure::drop) {
+            in_flight--;
+            n_dropped++;
+            return false;
+        }
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+    queued++;
+
+    if (sleeping > 0) {
+        lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+    return true;
+}
+
+
+void OutputQueue::flush() {
+    unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return in_flight == 0; });
+}
+
+
+string OutputQueue::error() const {
+    lock_guard<std::mutex> lock(mutex);
+    return first_error;
+}
+
+
+void OutputQueue::work() {
+    job_type job;
+    for (;;) {
+        if (try_pop(job)) {
+            queued--;
+            try {
+                job();
+            } catch (const exception &e) {
+                lock_guard<std::mutex> lock(mutex);
+                if (first_error.empty()) {
+                    first_error = e.what();
+                }
+            }
+            job = nullptr;
+            n_written++;
+
+            if (--in_flight == 0) {
+                lock_guard<std::mutex> lock(mutex);
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        // sleeping is raised before queued is read, and a push raises queued before it reads sleeping, so one of them
+        // sees the other
+        unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        wake.wait(lock, [this]() { return queued > 0 || stopping; });
+        sleeping--;
+        if (stopping && queued <= 0) {
+            return;
+        }
+    }
+}
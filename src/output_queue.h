@@ -0,0 +1,101 @@
+/*
+ * Writes output on I/O threads while the simulations carry on.
+ *
+ * A save copies what it writes into a job and hands it to a bounded queue; the I/O threads take the jobs in the order
+ * they were queued and run them. The queue is lock-free (a ring of slots with sequence numbers, so any number of
+ * simulations push and any number of threads pop without a lock); a mutex is only taken to wake sleeping I/O threads
+ * and to wait in flush().
+ *
+ * When the queue is full, push() either waits for a free slot (block) or gives the job up (drop), so that a disk that
+ * cannot keep up slows the simulations down or thins out their output. shared() is one queue for all simulations of
+ * the process, so that a sweep with a simulation per core does not start I/O threads per simulation; it is flushed
+ * when the process exits.
+ */
+
+#ifndef NC_OUTPUT_QUEUE_H
+#define NC_OUTPUT_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+enum class Backpressure {
+    block, // push() waits for a free slot
+    drop // push() gives the job up
+};
+
+
+class OutputQueue {
+public:
+
+    typedef std::function<void()> job_type;
+
+    // capacity is rounded up to a power of two
+    OutputQueue(int capacity, int n_threads);
+
+    // runs the jobs still queued and stops the threads
+    ~OutputQueue();
+
+    OutputQueue(const OutputQueue &) = delete;
+
+    OutputQueue &operator=(const OutputQueue &) = delete;
+
+    // the queue of the process, 64 jobs on two I/O threads, started on first use
+    static OutputQueue &shared();
+
+    // queues job, false if it was dropped
+    bool push(job_type job, Backpressure backpressure);
+
+    // waits until every job queued so far has run
+    void flush();
+
+    long written() const { return n_written; }
+
+    long dropped() const { return n_dropped; }
+
+    // the message of the first exception a job threw, empty if none did; jobs should handle their own errors
+    std::string error() const;
+
+private:
+
+    struct slot {
+        std::atomic<std::size_t> sequence;
+        job_type job;
+    };
+
+    bool try_push(job_type &job);
+
+    bool try_pop(job_type &job);
+
+    void work();
+
+    std::size_t mask;
+    std::unique_ptr<slot[]> slots;
+
+    // on their own cache lines, producers and I/O threads move them
+    alignas(64) std::atomic<std::size_t> push_position;
+    alignas(64) std::atomic<std::size_t> pop_position;
+
+    alignas(64) std::atomic<long> queued; // pushed, not yet taken by an I/O thread
+    std::atomic<long> in_flight; // pushed, not yet finished
+    std::atomic<int> sleeping;
+    std::atomic<bool> stopping;
+    std::atomic<long> n_written;
+    std::atomic<long> n_dropped;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::string first_error;
+
+    std::vector<std::thread> threads;
+};
+
+#endif //NC_OUTPUT_QUEUE_H
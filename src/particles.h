@@ -0,0 +1,32 @@
+/*
+ * Particle container used by the model, chosen at build time with the CMake option NC_PARTICLES
+ * (soa, the built-in container, or aboria).
+ *
+ * Both backends offer the same interface: size(), push_back(x), init_neighbour_search(low, high, bin_size),
+ * update_positions(), per-cell field references position(i), type(i), chain(i), direction(i), attached_to_id(i),
+ * chain_type(i), persistence_extent(i), same_dir_step(i), scaling(i), radius(i), the id(i) of a cell, index_of(id),
+ * set_reorder_interval(n) and the neighbour queries for_each_neighbour, any_neighbour and is_free.
+ *
+ * Indices i are only valid until the next update_positions(), since the container may reorder the cells then.
+ */
+
+#ifndef NC_PARTICLES_H
+#define NC_PARTICLES_H
+
+#ifdef NC_USE_ABORIA
+
+#include "aboria_particles.h"
+
+typedef AboriaParticles particle_type;
+
+#else
+
+#include "soa_particles.h"
+
+typedef SoaParticles particle_type;
+
+#endif
+
+typedef particle_type::vdouble2 vdouble2;
+
+#endif //NC_PARTICLES_H
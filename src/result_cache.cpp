@@ -0,0 +1,152 @@
+#include "result_cache.h"
+#include "code_version.h"
+#include "result_text.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char *result_suffix = ".result";
+
+
+// the results in a directory with their size and last use
+struct result_file {
+    string path;
+    size_t bytes;
+    double used; // seconds
+};
+
+static vector<result_file> list_results(const string &dir) {
+    vector<result_file> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return files;
+    }
+    const size_t suffix = strlen(result_suffix);
+    while (struct dirent *entry = readdir(d)) {
+        const string name = entry->d_name;
+        struct stat info;
+        if (name.size() > suffix && name.compare(name.size() - suffix, suffix, result_suffix) == 0 &&
+            stat((dir + "/" + name).c_str(), &info) == 0) {
+            files.push_back(result_file{dir + "/" + name, size_t(info.st_size),
+                                        double(info.st_mtim.tv_sec) + 1e-9 * double(info.st_mtim.tv_nsec)});
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+
+ResultCache::ResultCache(const string &directory, size_t max_bytes) : dir(directory), max_bytes(max_bytes) {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw runtime_error("cannot create " + dir + ": " + strerror(errno));
+    }
+}
+
+
+string ResultCache::key(const SimulationConfig &config, int seed) {
+    ostringstream key;
+    key.precision(numeric_limits<double>::max_digits10);
+    key << "code " << code_version() << " seed " << seed;
+    for (const string &name : SimulationConfig::parameter_names()) {
+        if (!SimulationConfig::output_parameter(name)) {
+            key << " " << name << " " << config.parameter(name);
+        }
+    }
+    return key.str();
+}
+
+
+string ResultCache::path_of(const string &key) const {
+    return dir + "/" + hex_string(fnv1a(key)) + result_suffix;
+}
+
+
+bool ResultCache::lookup(const SimulationConfig &config, int seed, CachedResult &result) {
+    const string k = key(config, seed);
+    const string path = path_of(k);
+
+    ifstream in(path);
+    string stored_key;
+    if (!getline(in, stored_key) || stored_key != k || !read_result(in, result.break_proportion, result.density)) {
+        return false;
+    }
+
+    // most recently used now
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return true;
+}
+
+
+void ResultCache::store(const SimulationConfig &config, int seed, double break_proportion, const VectorXi &density) {
+    const string k = key(config, seed);
+    const string path = path_of(k);
+    const string temporary = path + "." + to_string(getpid()) + ".tmp";
+
+    {
+        ofstream out(temporary);
+        out << k << "\n";
+        write_result(out, break_proportion, density);
+        out << "\n";
+        out.flush();
+        if (!out) {
+            remove(temporary.c_str());
+            return;
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return;
+    }
+
+    evict();
+}
+
+
+size_t ResultCache::size() const {
+    size_t bytes = 0;
+    for (const result_file &file : list_results(dir)) {
+        bytes += file.bytes;
+    }
+    return bytes;
+}
+
+
+void ResultCache::evict() {
+    lock_guard<mutex> lock(evict_mutex);
+
+    vector<result_file> files = list_results(dir);
+    size_t bytes = 0;
+    for (const result_file &file : files) {
+        bytes += file.bytes;
+    }
+    if (bytes <= max_bytes) {
+        return;
+    }
+
+    sort(files.begin(), files.end(), [](const result_file &a, const result_file &b) { return a.used < b.used; });
+    for (const result_file &file : files) {
+        if (bytes <= max_bytes) {
+            break;
+        }
+        if (remove(file.path.c_str()) == 0 || errno == ENOENT) {
+            bytes -= file.bytes; // or another process removed it already
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * On-disk cache of simulation results, addressed by their content: the key is a hash of every model parameter but
+ * those that only change the output (SimulationConfig::output_parameter), the seed and the code version
+ * (src/code_version.h), so a simulation that was run before by any process, with the same build of the model, is not
+ * run again.
+ *
+ * Each result is one small file <directory>/<key>.result holding the full key text, which guards against hash
+ * collisions, and the break proportion and the density of cells as src/result_text.h writes them. Files are written
+ * through a temporary name and a rename. A hit touches the file, and after every store the least recently used files
+ * are removed until the directory is within max_bytes. Processes may share a directory.
+ */
+
+#ifndef NC_RESULT_CACHE_H
+#define NC_RESULT_CACHE_H
+
+#include "simulation.h"
+
+#include <Eigen/Core>
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+
+struct CachedResult {
+    double break_proportion = 0;
+    Eigen::VectorXi density;
+};
+
+
+class ResultCache {
+public:
+
+    // results in directory, created if needed, of at most max_bytes, throws std::runtime_error if it cannot be created
+    ResultCache(const std::string &directory, size_t max_bytes);
+
+    const std::string &directory() const { return dir; }
+
+    // the stored result of config and seed, false if there is none
+    bool lookup(const SimulationConfig &config, int seed, CachedResult &result);
+
+    // stores a result and evicts the least recently used ones beyond max_bytes, failures only lose the entry
+    void store(const SimulationConfig &config, int seed, double break_proportion, const Eigen::VectorXi &density);
+
+    // what a result is stored under, all model parameters, the seed and the code version
+    static std::string key(const SimulationConfig &config, int seed);
+
+    // bytes of the results in the directory
+    size_t size() const;
+
+private:
+
+    std::string path_of(const std::string &key) const;
+
+    void evict();
+
+    std::string dir;
+    size_t max_bytes;
+    std::mutex evict_mutex;
+};
+
+#endif //NC_RESULT_CACHE_H
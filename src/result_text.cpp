@@ -0,0 +1,58 @@
+#include "result_text.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+using namespace std;
+using namespace Eigen;
+
+
+void write_result_number(ostream &out, double x) {
+    if (std::isnan(x)) {
+        out << "nan"; // not -nan, which 0/0 gives on some machines
+        return;
+    }
+    const streamsize precision = out.precision(numeric_limits<double>::max_digits10);
+    out << x;
+    out.precision(precision);
+}
+
+
+bool read_result_number(istream &in, double &x) {
+    string word;
+    if (!(in >> word)) {
+        return false;
+    }
+    char *end = nullptr;
+    x = strtod(word.c_str(), &end);
+    if (end != word.c_str() + word.size()) {
+        in.setstate(ios::failbit);
+        return false;
+    }
+    return true;
+}
+
+
+void write_result(ostream &out, double break_proportion, const VectorXi &density) {
+    write_result_number(out, break_proportion);
+    out << " " << density.size();
+    for (int i = 0; i < density.size(); ++i) {
+        out << " " << density(i);
+    }
+}
+
+
+bool read_result(istream &in, double &break_proportion, VectorXi &density) {
+    int parts = 0;
+    if (!read_result_number(in, break_proportion) || !(in >> parts) || parts < 0) {
+        in.setstate(ios::failbit);
+        return false;
+    }
+    density.resize(parts);
+    for (int i = 0; i < parts; ++i) {
+        in >> density(i);
+    }
+    return bool(in);
+}
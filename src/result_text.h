@@ -0,0 +1,31 @@
+/*
+ * The text of a simulation result, shared by the files that keep results between runs (SweepJournal, ResultCache and
+ * the finished jobs of a SweepSpool):
+ *
+ *     <break proportion> <number of parts> <cells in each part ...>
+ *
+ * The break proportion is NaN when no follower has entered the domain. It is written as nan and read with strtod, as
+ * reading a double from a stream does not take nan back.
+ */
+
+#ifndef NC_RESULT_TEXT_H
+#define NC_RESULT_TEXT_H
+
+#include <Eigen/Core>
+
+#include <istream>
+#include <ostream>
+
+
+// x at full precision, NaN as nan
+void write_result_number(std::ostream &out, double x);
+
+// a number written by write_result_number, false and in failed if the next word is not one
+bool read_result_number(std::istream &in, double &x);
+
+void write_result(std::ostream &out, double break_proportion, const Eigen::VectorXi &density);
+
+// false and in failed if the result is not complete
+bool read_result(std::istream &in, double &break_proportion, Eigen::VectorXi &density);
+
+#endif //NC_RESULT_TEXT_H
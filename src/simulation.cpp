@@ -0,0 +1,1772 @@
+/*
+IBM model for NC cells coupled to reaction-diffusion model for chemoattractant on a spatially non-uniformly growing domain,
+ model described in SI McKinney et al. (2019).
+
+*********************  MATLAB TDR SYSTEM  ************************************
+* Date created  : 2018, Jul 31
+* Author(s)     : Rasa Giniunaite (giniunaite@maths.ox.ac.uk)
+* Version       : 1.0
+* Revisions     : 1.0 initial version (Rasa Giniunaite)
+*
+*********************  COPYRIGHT NOTICE  *************************************
+* Copyright (C) 2019 Rasa Giniunaite
+*                         University of Oxford
+*                         United Kingdom
+******************************************************************************
+*/
+
+
+#include "simulation.h"
+#include "binary_io.h"
+#include "cell_trajectory.h"
+#include "field_pyramid.h"
+#include "growth_cache.h"
+#include "live_view.h"
+#include "output_queue.h"
+#include "snapshot_archive.h"
+#include "vtk_output.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace Eigen; // objects VectorXd, MatrixXd
+
+
+/*
+ * strain rate, piecewise constant in two parts
+ */
+
+VectorXd strain_rate(const SimulationConfig &config) {
+
+    const int length_x = config.length_x();
+    const double final_length = config.final_length;
+    const double final_time = config.final_time;
+    const double n_faster = config.n_faster;
+    const double thetasmall = config.thetasmall;
+
+    int theta1 = int(thetasmall * length_x);
+
+    double alpha1;
+    double alpha2;
+
+    //check whether first part grows
+    double thetasmalltemp = thetasmall;
+    if (config.first_part_grows == true) {
+        double xvar = final_length / (n_faster * double(length_x) * thetasmalltemp + double(length_x) * (1 -
+                                                                                                         thetasmalltemp));
+        // solve: 2 *xvar * length_x * thetasmall + x * length(1-thetasmall) = final_length
+
+        double ratio1 = n_faster * double(length_x) * thetasmalltemp * xvar / (double(length_x) * thetasmalltemp);
+
+        alpha1 = log(ratio1) / final_time;
+
+        double ratio2 = double(length_x) * (1 - thetasmalltemp) * xvar / (double(length_x) * (1 - thetasmalltemp));
+
+        alpha2 = log(ratio2) / final_time;
+
+    } else {
+        double xvar = final_length / (double(length_x) * thetasmall + n_faster * double(length_x) * (1 -
+                                                                                                     thetasmall));
+        // solve: 2 *xvar * length_x * thetasmall + x * length(1-thetasmall) = final_length
+
+        double ratio1 = double(length_x) * thetasmall * xvar / (double(length_x) * thetasmall);
+
+        alpha1 = log(ratio1) / final_time;
+
+        double ratio2 = double(length_x) * (1 - thetasmall) * xvar * n_faster / (double(length_x) * (1 - thetasmall));
+
+        alpha2 = log(ratio2) / final_time;
+    }
+
+
+    VectorXd strain = VectorXd::Zero(length_x);
+
+    // first part it is linear growth
+    for (int i = 0; i < theta1; i++) {
+        strain(i) = alpha1;
+    }
+
+    // second part is constant
+    for (int i = theta1; i < length_x; i++) {
+        strain(i) = alpha2;
+    }
+
+    return strain;
+}
+
+
+/*
+ * arbitrary Gamma function, Gamma_x at time t and its integral Gamma
+ */
+
+void growth_at(const VectorXd &strain, double t, double dx, VectorXd &Gamma_x, VectorXd &Gamma) {
+
+    const int length_x = int(strain.size());
+
+    // update the strain rate
+    for (int i = 0; i < length_x; i++) {
+        Gamma_x(i) = exp(t * strain(i));
+    }
+
+    Gamma(0) = 0; // this is assumption, since I cannot calculate it
+
+    for (int i = 1; i < length_x; i++) {
+        Gamma(i) = Gamma_x(i) * dx + Gamma(i - 1);
+    }
+}
+
+
+int SimulationConfig::number_of_steps() const {
+    int steps = 0;
+    for (double t = 0.0; t < final_time; t = t + dt) {
+        steps += 1;
+    }
+    return steps;
+}
+
+
+int SimulationConfig::density_bins() const {
+    double t = 0.0;
+    for (int i = 0; i < number_of_steps(); i++) {
+        t = t + dt;
+    }
+
+    VectorXd Gamma_x = VectorXd::Zero(length_x());
+    VectorXd Gamma = VectorXd::Zero(length_x());
+    growth_at(strain_rate(*this), t, dx, Gamma_x, Gamma);
+
+    return int(Gamma(length_x() - 1) / double(55)); // number of intervals of 50 \mu m
+}
+
+
+/*
+ * parameters by name
+ */
+
+namespace {
+
+    struct parameter_entry {
+        const char *name;
+        double SimulationConfig::*d;
+        int SimulationConfig::*i;
+        bool SimulationConfig::*b;
+    };
+
+#define NC_DOUBLE(name) {#name, &SimulationConfig::name, nullptr, nullptr}
+#define NC_INT(name) {#name, nullptr, &SimulationConfig::name, nullptr}
+#define NC_BOOL(name) {#name, nullptr, nullptr, &SimulationConfig::name}
+
+    const parameter_entry parameter_table[] = {
+            NC_BOOL(first_part_grows), NC_DOUBLE(space_grid_controller), NC_DOUBLE(domain_length),
+            NC_DOUBLE(domain_width), NC_DOUBLE(final_time), NC_DOUBLE(final_length), NC_DOUBLE(D), NC_DOUBLE(dt),
+            NC_DOUBLE(dx), NC_DOUBLE(dy), NC_DOUBLE(k_reac), NC_DOUBLE(cell_radius), NC_INT(N), NC_DOUBLE(l_filo_y),
+            NC_DOUBLE(l_filo_x), NC_DOUBLE(l_filo_max), NC_DOUBLE(speed_l), NC_DOUBLE(increase_fol_speed),
+            NC_DOUBLE(eps), NC_INT(same_dir), NC_BOOL(random_pers), NC_DOUBLE(lam), NC_DOUBLE(diff_conc),
+            NC_DOUBLE(n_faster), NC_DOUBLE(thetasmall), NC_INT(reorder_freq), NC_INT(save_freq),
+            NC_INT(checkpoint_freq), NC_INT(chemo_levels), NC_BOOL(cell_trajectory), NC_INT(live_view_freq), NC_INT(save_min_interval),
+            NC_DOUBLE(save_chemo_change), NC_INT(save_cell_change), NC_DOUBLE(save_front_change), NC_BOOL(async_output),
+            NC_BOOL(drop_output), NC_DOUBLE(telemetry_interval)
+    };
+
+#undef NC_DOUBLE
+#undef NC_INT
+#undef NC_BOOL
+
+    const parameter_entry &find_parameter(const string &name) {
+        for (const parameter_entry &p : parameter_table) {
+            if (name == p.name) {
+                return p;
+            }
+        }
+        throw invalid_argument("unknown model parameter " + name);
+    }
+}
+
+
+vector<string> SimulationConfig::parameter_names() {
+    vector<string> names;
+    for (const parameter_entry &p : parameter_table) {
+        names.push_back(p.name);
+    }
+    return names;
+}
+
+
+double SimulationConfig::parameter(const string &name) const {
+    const parameter_entry &p = find_parameter(name);
+    if (p.d) return this->*p.d;
+    if (p.i) return this->*p.i;
+    return this->*p.b ? 1 : 0;
+}
+
+
+void SimulationConfig::set_parameter(const string &name, double value) {
+    const parameter_entry &p = find_parameter(name);
+    if (p.d) {
+        this->*p.d = value;
+    } else if (p.i) {
+        this->*p.i = int(value);
+    } else {
+        this->*p.b = value != 0;
+    }
+}
+
+
+Simulation::Simulation(const SimulationConfig &config, int n_seed)
+        : config(config),
+          n_threads(1),
+          length_x(config.length_x()),
+          length_y(config.length_y()),
+          diameter(config.diameter()),
+          speed_f(config.increase_fol_speed * config.speed_l),
+          chemo_view(nullptr),
+          chemo_stride_x(0),
+          chemo_stride_y(0),
+          uniform(config.cell_radius, length_y - 1 - config.cell_radius),
+          uniformpi(0, 2 * M_PI),
+          n_dropped(0),
+          last_save(0),
+          saved_front(0) {
+
+    if (config.chemo_format != "csv" && config.chemo_format != "vtr" && config.chemo_format != "vtr32" &&
+        config.chemo_format != "archive" && config.chemo_format != "archive_z" &&
+        config.chemo_format != "archive_q16") {
+        throw invalid_argument("unknown chemoattractant output format " + config.chemo_format);
+    }
+    if (config.chemo_levels < 1) {
+        throw invalid_argument("chemo_levels is " + to_string(config.chemo_levels) + ", at least 1");
+    }
+
+    if (!config.live_view.empty()) {
+        live = make_shared<LiveViewPublisher>(config.live_view, length_x, length_y, 4096);
+    }
+
+    if (!config.telemetry.empty()) {
+        telemetry = Telemetry::open(config.telemetry);
+    }
+
+    strain = strain_rate(config);
+
+    if (!config.growth_cache.empty()) {
+        growth = GrowthTrajectory::open(config, config.growth_cache);
+    }
+
+    reset(n_seed);
+}
+
+
+void Simulation::reset(int n_seed) {
+
+    this->n_seed = n_seed;
+
+    const double cell_radius = config.cell_radius;
+    const int N = config.N;
+
+    t = 0.0; // initialise time
+    counter = 0;
+    value = 0;
+    count_dir = 0;
+    saves.clear();
+    earlier_prefixes.clear();
+    n_dropped = 0;
+
+    telemetry_job = "s" + to_string(n_seed);
+    phase_time.fill(0);
+    started = chrono::steady_clock::now();
+    last_report = started;
+    last_report_step = 0;
+
+
+    // growth function
+
+    Gamma_x = VectorXd::Zero(length_x);
+    Gamma = VectorXd::Zero(length_x);
+    Gamma_t = VectorXd::Zero(length_x);
+    Gamma_old = VectorXd::Zero(length_x);
+
+    for (int i = 0; i < length_x; i++) {
+        Gamma_x(i) = exp(0 * strain(i));
+        Gamma(i) = i;
+        Gamma_old(i) = Gamma(i);
+    }
+
+
+    /*
+    * initialise a matrix that stores values of concentration of chemoattractant
+    */
+
+    chemo.setOnes(length_x, length_y);
+    chemo_new.setOnes(length_x, length_y); // this is for later updates
+
+    // initialise internalisation matrix
+    intern.setZero(length_x, length_y);
+
+
+    /*
+     * initial cells of fixed radius, all leaders, at x = cell_radius and uniformly in y
+     */
+
+    particles = particle_type(N);
+
+    for (int i = 0; i < N; ++i) {
+
+        particles.radius(i) = cell_radius;
+        particles.type(i) = 0; // initially all cells are leaders
+
+        particles.position(i) = vdouble2(cell_radius, (i + 1) * double(length_y - 1) / double(N) -
+                                                      0.5 * double(length_y - 1) /
+                                                      double(N)); // x=2, uniformly in y
+        particles.persistence_extent(i) = 0;
+        particles.same_dir_step(i) = 0;
+    }
+
+    // initialise neighbourhood search, note that the domain will grow in x direction, so I initialise larger domain
+    // bins of the search are one cell diameter wide
+    particles.init_neighbour_search(vdouble2(0, 0), 5 * vdouble2(double(length_x), double(length_y)), diameter);
+
+    // sort the particle arrays along a space filling curve every reorder_freq searches (two per timestep), so that
+    // cells close to each other are also close in memory
+    particles.set_reorder_interval(config.reorder_freq);
+
+
+    // random number generators, gen for the y position of new cells, gen1 for the directions
+    gen = std::default_random_engine();
+    gen1 = std::default_random_engine();
+    gen1.seed(t * n_seed); // choose different seeds to obtain different random numbers
+
+    // adaptive saving compares with the initial state until the first save
+    set_save_baseline();
+}
+
+
+void Simulation::reseed(int n_seed) {
+    this->n_seed = n_seed;
+    gen.seed(n_seed);
+    gen1.seed(n_seed);
+}
+
+
+/*
+ * checkpoints
+ */
+
+static const char *checkpoint_header = "nc checkpoint 3";
+static const char *checkpoint_header_2 = "nc checkpoint 2"; // without the earlier output prefixes
+static const char *checkpoint_header_1 = "nc checkpoint 1"; // without the saves
+
+// parameters that only change the output, a checkpoint may be read with other values and results are cached without them
+bool SimulationConfig::output_parameter(const string &name) {
+    for (const char *output : {"save_freq", "checkpoint_freq", "chemo_levels", "cell_trajectory", "live_view_freq", "save_min_interval",
+                               "save_chemo_change", "save_cell_change", "save_front_change", "async_output",
+                               "drop_output", "telemetry_interval"}) {
+        if (name == output) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// writes bytes to path through a temporary file and a rename, so that readers never see a partial checkpoint, returns
+// the error if that failed
+static string write_replacing(const string &path, const string &bytes) {
+    const string temporary = path + ".tmp";
+    {
+        ofstream out(temporary, ios::binary);
+        out.write(bytes.data(), streamsize(bytes.size()));
+        out.flush();
+        if (!out) {
+            return "cannot write the checkpoint " + temporary;
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        return "cannot write the checkpoint " + path;
+    }
+    return "";
+}
+
+
+struct BackgroundWrite {
+    thread writer;
+    string error;
+
+    ~BackgroundWrite() {
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+};
+
+
+void Simulation::write_checkpoint(ostream &out) const {
+    write_binary(out, string(checkpoint_header));
+
+    const vector<string> names = SimulationConfig::parameter_names();
+    write_binary(out, uint64_t(names.size()));
+    for (const string &name : names) {
+        write_binary(out, name);
+        write_binary(out, config.parameter(name));
+    }
+
+    write_binary(out, n_seed);
+    write_binary(out, t);
+    write_binary(out, counter);
+    write_binary(out, value);
+    write_binary(out, count_dir);
+
+    write_binary(out, Gamma_x);
+    write_binary(out, Gamma);
+    write_binary(out, Gamma_t);
+    write_binary(out, Gamma_old);
+
+    write_binary(out, chemo); // chemo_new is the same at the end of a timestep
+    write_binary(out, intern);
+
+    particles.write(out);
+
+    write_engine(out, gen);
+    write_engine(out, gen1);
+
+    write_binary(out, saves);
+    write_binary(out, last_save);
+    write_binary(out, saved_front);
+    write_binary(out, saved_chain);
+    write_binary(out, saved_chemo);
+
+    write_binary(out, uint64_t(earlier_prefixes.size()));
+    for (const pair<int, string> &earlier : earlier_prefixes) {
+        write_binary(out, earlier.first);
+        write_binary(out, earlier.second);
+    }
+
+    if (!out) {
+        throw runtime_error("cannot write a checkpoint");
+    }
+}
+
+
+void Simulation::write_checkpoint(const string &path) const {
+    ostringstream out(ios::binary);
+    write_checkpoint(out);
+    const string error = write_replacing(path, out.str());
+    if (!error.empty()) {
+        throw runtime_error(error);
+    }
+}
+
+
+void Simulation::read_checkpoint(istream &in) {
+    string header;
+    read_binary(in, header);
+    if (!in || (header != checkpoint_header && header != checkpoint_header_2 && header != checkpoint_header_1)) {
+        throw runtime_error("not a checkpoint");
+    }
+
+    uint64_t n_parameters = 0;
+    read_binary(in, n_parameters);
+    for (uint64_t p = 0; p < n_parameters && in; ++p) {
+        string name;
+        double stored = 0;
+        read_binary(in, name);
+        read_binary(in, stored);
+        if (in && !SimulationConfig::output_parameter(name) && stored != config.parameter(name)) {
+            throw runtime_error("the checkpoint was written with " + name + " = " + to_string(stored) + ", not " +
+                                to_string(config.parameter(name)));
+        }
+    }
+
+    read_binary(in, n_seed);
+    read_binary(in, t);
+    read_binary(in, counter);
+    read_binary(in, value);
+    read_binary(in, count_dir);
+
+    read_binary(in, Gamma_x);
+    read_binary(in, Gamma);
+    read_binary(in, Gamma_t);
+    read_binary(in, Gamma_old);
+
+    read_binary(in, chemo);
+    read_binary(in, intern);
+    chemo_new = chemo;
+
+    particles.read(in);
+
+    read_engine(in, gen);
+    read_engine(in, gen1);
+
+    if (header != checkpoint_header_1) {
+        read_binary(in, saves);
+        read_binary(in, last_save);
+        read_binary(in, saved_front);
+        read_binary(in, saved_chain);
+        read_binary(in, saved_chemo);
+        if (config.save_chemo_change > 0 && saved_chemo.size() != chemo.size()) {
+            saved_chemo = chemo; // written without adaptive saving
+        }
+    } else {
+        // the saves of the fixed cadence up to now
+        saves.clear();
+        for (int n = config.save_freq; config.save_freq > 0 && n <= counter; n += config.save_freq) {
+            saves.push_back(n);
+        }
+        set_save_baseline();
+    }
+
+    earlier_prefixes.clear();
+    if (header == checkpoint_header) {
+        uint64_t n_earlier = 0;
+        read_binary(in, n_earlier);
+        for (uint64_t k = 0; k < n_earlier && in; ++k) {
+            pair<int, string> earlier;
+            read_binary(in, earlier.first);
+            read_binary(in, earlier.second);
+            earlier_prefixes.push_back(earlier);
+        }
+    }
+
+    if (!in || chemo.rows() != length_x || chemo.cols() != length_y || Gamma.size() != length_x) {
+        throw runtime_error("the checkpoint is incomplete");
+    }
+}
+
+
+void Simulation::read_checkpoint(const string &path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw runtime_error("cannot read the checkpoint " + path);
+    }
+    read_checkpoint(in);
+}
+
+
+void Simulation::wait_for_checkpoint() {
+    if (!checkpoint_writer) {
+        return;
+    }
+    checkpoint_writer->writer.join();
+    const string error = checkpoint_writer->error;
+    checkpoint_writer.reset();
+    if (!error.empty()) {
+        throw runtime_error(error);
+    }
+}
+
+
+void Simulation::checkpoint_in_background() {
+    wait_for_checkpoint();
+
+    // the copy is consistent, the simulation carries on while it is written
+    shared_ptr<string> state = make_shared<string>();
+    {
+        ostringstream out(ios::binary);
+        write_checkpoint(out);
+        *state = out.str();
+    }
+
+    shared_ptr<BackgroundWrite> background = make_shared<BackgroundWrite>();
+    const string path = checkpoint_path();
+    BackgroundWrite *w = background.get();
+    w->writer = thread([w, state, path]() { w->error = write_replacing(path, *state); });
+    checkpoint_writer = background;
+}
+
+
+void Simulation::run() {
+    while (!finished()) {
+        step();
+    }
+    wait_for_output();
+}
+
+
+void Simulation::place_on_numa_node(int node, bool huge_pages) {
+    for (MatrixXd *grid : {&chemo, &chemo_new, &intern}) {
+        bind_to_numa_node(grid->data(), grid->size() * sizeof(double), node, huge_pages);
+    }
+}
+
+
+NumaPageCount Simulation::numa_pages(int node) const {
+    NumaPageCount count;
+    for (const MatrixXd *grid : {&chemo, &chemo_new, &intern}) {
+        count += count_numa_pages(grid->data(), grid->size() * sizeof(double), node);
+    }
+    return count;
+}
+
+
+void Simulation::step() {
+
+    // wall time of each phase, for the telemetry
+    auto mark = chrono::steady_clock::now();
+    auto lap = [&](TelemetryPhase phase) {
+        const auto now = chrono::steady_clock::now();
+        phase_time[phase] += chrono::duration<double>(now - mark).count();
+        mark = now;
+    };
+
+    insert_cells();
+    lap(phase_insert);
+
+    t = t + config.dt;
+
+    counter = counter + 1;
+
+    grow_domain();
+    lap(phase_growth);
+
+    update_chemo();
+    lap(phase_chemo);
+
+    move_cells();
+    lap(phase_cells);
+
+    // since dt = 0.01, which is 1/5 of a minute, this means that I save every 7min
+    if (save_due()) {
+        save();
+    }
+
+    if (checkpoint_due()) {
+        checkpoint_in_background();
+    }
+
+    if (live_view_due()) {
+        publish_live_view();
+    }
+    lap(phase_output);
+
+    if (telemetry) {
+        report_progress(mark);
+    }
+}
+
+
+void Simulation::insert_cells() {
+
+    const double cell_radius = config.cell_radius;
+
+    bool free_position = false;
+    vdouble2 f_position = vdouble2(cell_radius, uniform(gen)); // x=2, uniformly in y
+    /*
+     * check all neighbouring cells within "dem_diameter" distance
+     */
+    free_position = particles.is_free(f_position, diameter);
+
+    if (free_position) {
+        size_t f = particles.push_back(f_position);
+        // our assumption that all new cells are followers
+        particles.type(f) = 1;
+        particles.chain(f) = 0;
+        particles.chain_type(f) = -1;
+        particles.attached_to_id(f) = -1;
+    }
+
+    particles.update_positions();
+}
+
+
+void Simulation::grow_domain() {
+
+    /*
+    *
+    * Domain growth, and update cell positions
+    */
+
+    if (growth && growth->covers(counter)) {
+        growth->load(counter, Gamma_x, Gamma);
+    } else {
+        growth_at(strain, t, config.dx, Gamma_x, Gamma);
+    }
+
+    move_with_domain();
+}
+
+
+void Simulation::move_with_domain() {
+
+    const double dt = config.dt;
+
+    // I need Gamma_t for cos verification as well
+
+    for (int i = 0; i < length_x; ++i) {
+
+        Gamma_t(i) = (Gamma(i) - Gamma_old(i)) / dt;
+
+    }
+
+
+
+    /// update positions uniformly based on the domain growth
+
+    vdouble2 x; // use variable x for the position of cells
+    double x0 = 0;
+    int pos;
+
+    for (int i = 0; i < particles.size(); i++) {
+
+        x = particles.position(i);
+
+        // since I do not know how to do it for general case, I will do it for my specific
+
+
+        int j = 0;
+        while (x[0] > Gamma_old(j)) {
+            value = j;
+            j = j + 1;
+            //cout << "value " << value << endl;
+
+        }
+
+
+        particles.scaling(i) = value;
+
+//            x[0] = x[0] + Gamma(value)-Gamma_old(value);
+
+        particles.position(i) += vdouble2(Gamma(value) - Gamma_old(value), 0);
+
+
+    }
+
+
+    Gamma_old = Gamma;
+}
+
+
+void Simulation::update_chemo() {
+
+    const double cell_radius = config.cell_radius;
+    const double D = config.D;
+    const double dt = config.dt;
+    const double dx = config.dx;
+    const double dy = config.dy;
+    const double k_reac = config.k_reac;
+    const double lam = config.lam;
+
+    /*
+     * update chamo concentration
+     *
+     * */
+
+
+    // internalisation, every thread has its own rows of the grid so the sums do not depend on the number of threads
+#pragma omp parallel for num_threads(n_threads) if(n_threads > 1) schedule(static)
+    for (int i = 0; i < length_x; i++) {
+        for (int j = 0; j < length_y; j++) {
+            //go through all the cells
+            for (int k = 0; k < particles.size(); k++) {
+                // leaders
+                //for (int k = 0; k < N; k++) {
+                vdouble2 x;
+                x = particles.position(k);
+                intern(i, j) = intern(i, j) + exp(-((Gamma(i) - x[0]) *
+                                                    (Gamma(i) - x[0]) +
+                                                    (j - x[1]) * (j - x[1])) /
+                                                  (2 * cell_radius * cell_radius)); // mapping to fixed domain
+            }
+        }
+    }
+
+
+
+    // inner coefficients
+
+
+#pragma omp parallel for num_threads(n_threads) if(n_threads > 1) schedule(static)
+    for (int i = 1; i < length_x - 1; ++i) {
+        for (int j = 1; j < length_y - 1; ++j) {
+
+            chemo_new(i, j) = dt * (D * 1.0 / (2.0 * dx * dx * Gamma_x(i)) *
+                                    ((1.0 / Gamma_x(i) + 1.0 / Gamma_x(i + 1)) * (chemo(i + 1, j) - chemo(i, j)) -
+                                     (chemo(i, j) - chemo(i - 1, j)) * (1.0 / Gamma_x(i) + 1.0 / Gamma_x(i - 1))) +
+                                    D * (chemo(i, j + 1) - 2 * chemo(i, j) + chemo(i, j - 1)) / (dy * dy) -
+                                    (chemo(i, j) * lam / (2 * M_PI * cell_radius * cell_radius)) * intern(i, j) +
+                                    chemo(i, j) * k_reac * (1 - chemo(i, j)) - strain(i) * chemo(i, j)) +
+                              chemo(i, j);
+        }
+    }
+
+
+    for (int i = 0; i < length_y; i++) {
+        chemo_new(0, i) = chemo_new(1, i);
+        chemo_new(length_x - 1, i) = chemo_new(length_x - 2, i);
+
+    }
+
+    for (int i = 0; i < length_x; i++) {
+        chemo_new(i, 0) = chemo_new(i, 1);
+        chemo_new(i, length_y - 1) = chemo_new(i, length_y - 2);
+    }
+
+
+    chemo = chemo_new; // update chemo concentration
+}
+
+
+void Simulation::move_cells() {
+
+    const double cell_radius = config.cell_radius;
+    const int N = config.N;
+    const double diff_conc = config.diff_conc;
+    const double l_filo_x_in = config.l_filo_x; // this value is used for rescaling when domain grows based on initial value
+    double l_filo_x = config.l_filo_x;
+    const double l_filo_y = config.l_filo_y;
+    const double l_filo_max = config.l_filo_max;
+    const double speed_l = config.speed_l;
+    const double increase_fol_speed = config.increase_fol_speed;
+    const double eps = config.eps;
+    const int same_dir = config.same_dir;
+    const bool random_pers = config.random_pers;
+
+    /*
+     * Update the position of particles
+     * */
+
+
+    //  create a random list of cell ids
+    int check_rep = 0; // check for repetitions, 0 no rep, 1 rep
+
+
+    std::default_random_engine gen2;
+    gen2.seed(t * n_seed); // different seeds
+    std::uniform_real_distribution<double> uniform_particles(0, particles.size()); // can only move forward
+
+    VectorXi particle_id = VectorXi::Zero(particles.size());
+
+    for (int i = 0; i < particles.size(); i++) {
+
+        check_rep = 1; // set to 1 to enter the while loop
+        while (check_rep == 1) {
+            check_rep = 0; // it is initially zero and then will be changed to 1 if it is equivalent to others
+            particle_id(i) = uniform_particles(gen2);
+
+
+            for (int j = 0; j < i; j++) {
+                if (particle_id(i) == particle_id(j)) { check_rep = 1; }
+            }
+        }
+    }
+
+    // the particle arrays may have been reordered, so look up where each of these cells is stored
+    for (int i = 0; i < particles.size(); i++) {
+        particle_id(i) = particles.index_of(particle_id(i));
+    }
+
+    // update the position of all particles in a random order created above
+
+    for (int j = 0; j < particles.size(); j++) {
+
+
+        // if a particle is a leader
+
+
+        vdouble2 x; // use variable x for the position of cells
+        x = particles.position(particle_id(j));
+
+        if (particles.type(particle_id(j)) == 0) {
+
+            vdouble2 x; // use variable x for the position of cells
+            x = particles.position(particle_id(j));
+
+
+            double x_in; // x coordinate in initial domain length scale
+
+
+            x_in = particles.scaling(particle_id(j));
+            l_filo_x = l_filo_x_in * particles.scaling(particle_id(j)) /
+                       Gamma(particles.scaling(particle_id(j)));
+
+
+            // if it is still in the process of moving in the same direction
+            if (particles.persistence_extent(particle_id(j)) == 1) {
+
+
+                bool free_position = true; // check if the neighbouring position is free
+
+                // check if there are other particles in the position where the particle wants to move
+                free_position = particles.is_free(x, diameter, particle_id(j)); // not counting the same particle
+
+                // check that the position they want to move to is free and not out of bounds
+                if (free_position && x[0] > cell_radius && x[0] < Gamma(length_x - 1) && (x[1]) > cell_radius &&
+                    (x[1]) < length_y - 1 - cell_radius) {
+                    // if that is the case, move into that position
+                    particles.position(particle_id(j)) +=
+                            particles.direction(particle_id(j));
+                }
+                particles.same_dir_step(particle_id(
+                        j)) += 1; // add regardless whether the step happened or no to that count of the number of
+                // movement in the same direction
+
+            }
+
+
+            // if a particle is not in a sequence of persistent steps
+            if (particles.persistence_extent(particle_id(j)) == 0) {
+
+
+
+                // create an array to store random directions
+                array<double, filo_number + 1> random_angle;
+
+                // choose the number of angles where the filopodia is sent
+                for (int k = 0; k < filo_number + 1; k++) {
+
+                    double random_angle_tem = uniformpi(gen1);
+                    int sign_x_tem, sign_y_tem;
+
+                    random_angle_tem = uniformpi(gen1);
+                    random_angle[k] = random_angle_tem;
+
+                }
+
+
+                // choose which direction to move
+
+
+                // store variables for concentration at new locations
+
+
+                double old_chemo = chemo_at(int(round(x_in)), int(round(x[1])));
+                array<double, filo_number> new_chemo;
+
+
+                for (int i = 0; i < filo_number; i++) {
+
+                    if (round((x_in + sin(random_angle[i]) * l_filo_x)) < 0 ||
+                        round((x_in + sin(random_angle[i]) * l_filo_x)) >
+                        length_x - 1 || round(x[1] + cos(random_angle[i]) * l_filo_y) < 0 ||
+                        round(x[1] + cos(random_angle[i]) * l_filo_y) > length_y - 1) {
+                        new_chemo[i] = 0;
+                    } else {
+
+                        new_chemo[i] = chemo_at(int(round((x_in + sin(random_angle[i]) * l_filo_x))),
+                                             int(round(x[1] + cos(random_angle[i]) * l_filo_y)));
+                    }
+
+                }
+
+
+                // find maximum concentration of chemoattractant
+
+                int chemo_max_number = 0;
+
+                for (int i = 1; i < filo_number; i++) {
+                    if (new_chemo[chemo_max_number] < new_chemo[i]) {
+                        chemo_max_number = i;
+                    }
+                }
+
+                // if the concentration in a new place is relatively higher than the old one (diff_conc determines
+                // that threshold), move that way
+                if ((new_chemo[chemo_max_number] - old_chemo) / sqrt(old_chemo) > diff_conc) {
+
+                    count_dir += 1;
+
+                    x += speed_l *
+                         vdouble2(sin(random_angle[chemo_max_number]), cos(random_angle[chemo_max_number]));
+
+
+                    bool free_position = true; // check if the neighbouring position is free
+
+                    // check if the position the particle wants to move is free
+                    free_position = particles.is_free(x, diameter, particle_id(j)); // not counting the same particle
+
+
+                    // if the position they want to move to is free and not out of bounds, move that direction
+                    if (free_position && x[0] > cell_radius && x[0] < Gamma(length_x - 1) && (x[1]) > cell_radius &&
+                        (x[1]) < length_y - 1 - cell_radius) {
+                        particles.position(particle_id(j)) +=
+                                speed_l * vdouble2(sin(random_angle[chemo_max_number]),
+                                                   cos(random_angle[chemo_max_number])); // update if nothing is in
+                        // the next position
+                        particles.direction(particle_id(j)) =
+                                speed_l * vdouble2(sin(random_angle[chemo_max_number]),
+                                                   cos(random_angle[chemo_max_number]));
+
+                        // if there is some kind of tendency to move persistently
+                        if (same_dir > 0) {
+                            particles.persistence_extent(particle_id(
+                                    j)) = 1; // assume for now that it also becomes peristent in random direction
+
+                        }
+
+                    }
+
+
+                }
+
+                    // if the concentration is not higher, move in random direction
+                else {
+
+
+                    x += speed_l * vdouble2(sin(random_angle[filo_number]), cos(random_angle[filo_number]));
+
+
+                    bool free_position = true; // check if the neighbouring position is free
+
+                    // if this loop is entered, it means that there is another cell where I want to move
+                    free_position = particles.is_free(x, diameter, particle_id(j)); // not counting the same particle
+
+
+                    // update the position if the place they want to move to is free and not out of bounds
+                    if (free_position && x[0] > cell_radius && x[0] < Gamma(length_x - 1) && (x[1]) > cell_radius &&
+                        (x[1]) < length_y - 1 - cell_radius) {
+                        particles.position(particle_id(j)) +=
+                                speed_l * vdouble2(sin(random_angle[filo_number]),
+                                                   cos(random_angle[filo_number])); // update if nothing is in the next position
+                        particles.direction(particle_id(j)) =
+                                speed_l * vdouble2(sin(random_angle[filo_number]),
+                                                   cos(random_angle[filo_number]));
+                        // if particles start moving persistently in all directions
+                        if (random_pers) {
+                            if (same_dir > 0) {
+                                particles.persistence_extent(particle_id(
+                                        j)) = 1; // assume for now that it also becomes peristent in random direction
+
+                            }
+                        }
+
+                    }
+
+                }
+
+            }
+
+            // check if it is not the end of moving in the same direction
+            if (particles.same_dir_step(particle_id(j)) > same_dir) {
+                particles.persistence_extent(particle_id(j)) = 0;
+                particles.same_dir_step(particle_id(j)) = 0;
+            }
+
+        }
+
+
+
+
+        // if a particle is a follower
+        if (particles.type(particle_id(j)) == 1) {
+
+            vdouble2 x;
+            x = particles.position(particle_id(j));
+
+            double x_in; // x coordinate in initial domain length scale
+
+
+            x_in = particles.scaling(particle_id(j));
+            l_filo_x = l_filo_x_in * particles.scaling(particle_id(j)) /
+                       Gamma(particles.scaling(particle_id(j)));
+
+            // if the particle is part of the chain
+            if (particles.chain(particle_id(j)) > 0) {
+
+
+                // check if it is not too far from the cell it was following
+
+                vdouble2 dist;
+
+                dist = particles.position(particle_id(j)) -
+                       particles.position(particles.index_of(particles.attached_to_id(particle_id(j))));
+
+
+                // if it is sufficiently far dettach the cell
+                if (dist.norm() > l_filo_max) {
+                    particles.chain(particle_id(j)) = 0;
+                    //dettach also all the cells that are behind it, so that other cells would not be attached to this chain
+                    for (int i = 0; i < particles.size(); ++i) {
+                        if (particles.chain_type(i) == particles.chain_type(particle_id(j))) {
+                            // particles.chain_type(i) = -1;
+                            particles.chain(i) = 0;
+                        }
+
+                    }
+                    // particles.chain_type(particle_id(j)) = -1;
+                }
+
+
+                // direction the same as of the cell it is attached to
+                particles.direction(particle_id(j)) = particles.direction(
+                        particles.index_of(particles.attached_to_id(particle_id(j))));
+
+                //try to move in the same direction as the cell it is attached to
+                vdouble2 x_chain = x + increase_fol_speed * particles.direction(particle_id(j));
+
+                double x_in_chain; // scaled coordinate
+
+
+
+                bool free_position = true;
+
+                // check if the position it wants to move to is free
+                free_position = particles.is_free(x_chain, diameter, particle_id(j)); // not counting the same particle
+
+
+                // update the position if the place they want to move to is free and not out of bounds
+                if (free_position && x_chain[0] > cell_radius && x_chain[0] < Gamma(length_x - 1) &&
+                    (x_chain[1]) > cell_radius &&
+                    (x_chain[1]) < length_y - 1 - cell_radius) {
+                    particles.position(particle_id(j)) +=
+                            increase_fol_speed * particles.direction(particle_id(j));
+
+                }
+            }
+
+            // if the cell is not part of the chain
+            if (particles.chain(particle_id(j)) == 0) {
+
+
+                /* check if there are any cells distance l_filo_y apart
+                * it can be either a leader or a follower already in a chain
+                */
+
+
+                particles.for_each_neighbour(x, l_filo_x_in, [&](size_t k) {
+
+
+                    if (particles.type(k) == 0) { // if it is close to a leader
+                        particles.direction(particle_id(j)) = particles.direction(k); // set the same direction
+                        particles.chain(particle_id(j)) = 1; // note that it is directly attached to a leader
+                        particles.attached_to_id(particle_id(j)) = particles.id(
+                                k); // note the id of the particle it is attached to
+                        particles.chain_type(particle_id(j)) = particles.id(
+                                k); // chain type is the id of the leader
+                    }
+
+                });
+
+
+                // if it hasn't found a leader nearby,
+                // try to find a close follower which is in a chain contact with a leader
+
+                if (particles.chain(particle_id(j)) != 1) {
+                    particles.for_each_neighbour(x, l_filo_y, [&](size_t k) {
+
+                        // if it is close to a follower that is part of the chain
+                        if (particles.type(k) == 1 && particles.chain(k) > 0) {
+
+                            if (particles.id(k) != particles.id(particle_id(j))) {
+                                //check if there is a leader in front of the chain
+                                particles.direction(particle_id(j)) = particles.direction(k);
+                                particles.chain(particle_id(j)) =
+                                        particles.chain(k) + 1; // it is subsequent member of the chain
+                                particles.attached_to_id(particle_id(j)) = particles.id(
+                                        k); // id of the particle it is attached to
+                                particles.chain_type(particle_id(j)) = particles.chain_type(k); // chain type is
+                                // the same as the one of the particle it is attached to
+
+
+                            }
+
+
+                        }
+
+                    });
+                }
+
+                // try to move if it has found something
+
+                if (particles.chain(particle_id(j)) > 0) {
+
+                    //try to move in the same direction as the cell it is attached to
+                    vdouble2 x_chain = x + increase_fol_speed * particles.direction(particle_id(j));
+
+                    // Non-uniform domain growth
+                    double x_in_chain;
+
+
+                    bool free_position = true;
+
+
+                    // check if the position it wants to move is free
+                    free_position = particles.is_free(x_chain, diameter, particle_id(j)); // not counting the same particle
+
+
+                    // if the position is free and not out of bounds, move that direction
+                    if (free_position &&
+                        x_chain[0] > cell_radius &&
+                        x_chain[0] < Gamma(length_x - 1) && (x_chain[1]) > cell_radius &&
+                        (x_chain[1]) < length_y - 1 - cell_radius) {
+                        //cout << "direction " << particles.direction(particle_id(j)) << endl;
+                        particles.position(particle_id(j)) +=
+                                increase_fol_speed * particles.direction(particle_id(j));
+
+                    }
+                }
+
+
+                // if it hasn't found anything close, move randomly
+
+                if (particles.chain(particle_id(j)) == 0) {
+
+                    double random_angle = uniformpi(gen1);
+
+
+                    x += speed_f * vdouble2(sin(random_angle), cos(random_angle));
+
+
+                    bool free_position = true; // check if the neighbouring position is free
+
+                    // check if the position the cells want to move to is free
+                    free_position = particles.is_free(x, diameter, particle_id(j)); // not counting the same particle
+
+                    // if the position they want to move to is free and not out of bounds, move to that position
+                    if (free_position && x[0] > cell_radius && x[0] < Gamma(length_x - 1) && (x[1]) > cell_radius &&
+                        (x[1]) < length_y - 1 - cell_radius) {
+                        particles.position(particle_id(j)) += speed_f * vdouble2(sin(random_angle),
+                                                                                       cos(random_angle)); // update
+                        // if nothing is in the next position
+                        particles.direction(particle_id(j)) = speed_f * vdouble2(sin(random_angle),
+                                                                                       cos(random_angle)); // update direction as well
+                    }
+
+                }
+
+            }
+
+            /* CHECK IF A FOLLOWER DOES NOT BECOME A LEADER
+            * Alternative phenotypic switching if a follower overtakes a leader it becomes a leader and that leader follower.
+            * I will have to be careful when there will be channels because I will have to choose the closest leader
+            * */
+
+
+            // find the closest leader
+
+
+            // so that I would not go through all the cells I will choose the ones that are closer to the front
+
+            // minimum position in x of the leaders, leaders are the cells with ids 0 to N - 1
+
+            int min_index = 0;
+
+            for (int i = 1; i < N; ++i) {
+                if (particles.position(particles.index_of(i))[0] <
+                    particles.position(particles.index_of(min_index))[0]) {
+                    min_index = i;
+                }
+
+            }
+
+            // if a follower is eps further in front than the leader, swap their types
+            if (particles.position(particle_id(j))[0] > particles.position(particles.index_of(min_index))[0] + eps) {
+                // find distance to all the leaders
+                // leaders not measured yet are never the closest
+                vector<double> distances(N, numeric_limits<double>::max());
+                vdouble2 dist_vector;
+                //check which one is the closest
+                for (int i = 0; i < N; ++i) {
+                    dist_vector = particles.position(particle_id(j)) - particles.position(particles.index_of(i));
+                    distances[i] = dist_vector.norm();
+
+                    int winning_index = 0;
+                    for (int i = 1; i < N; ++i) {
+                        if (distances[i] < distances[winning_index]) {
+                            winning_index = i;
+                        }
+                    }
+
+                    // if this closest leader is behind that follower, swap them
+                    if (particles.position(particle_id(j))[0] >
+                        particles.position(particles.index_of(winning_index))[0] + eps) {
+                        // their position swap
+
+                        vdouble2 temp = particles.position(particles.index_of(winning_index));
+                        particles.position(particles.index_of(winning_index)) = particles.position(particle_id(j));
+                        particles.position(particle_id(j)) = temp;
+
+
+                    }
+
+                }
+
+
+            }
+
+        }
+
+    }
+
+    // update positions
+    particles.update_positions();
+}
+
+
+// the chemoattractant snapshot of timestep step in format, stem the name of its file for the formats with a file per
+// snapshot, vtr_datasets the .pvd index including it
+static void write_chemo_snapshot(const string &format, const string &prefix, const string &stem, double t, int step,
+                                 const VectorXd &x, const VectorXd &y, const MatrixXd &u,
+                                 const vector<pair<double, string>> &vtr_datasets) {
+    if (format.compare(0, 7, "archive") == 0) {
+        ArchiveOptions options;
+        options.compress = format != "archive";
+        options.quantise16 = format == "archive_q16";
+        append_snapshot(prefix + "ChemoConc.nca", options, t, step, x, y, u);
+        return;
+    }
+    if (format != "csv") {
+        write_vtr(prefix + stem + ".vtr", x, y, u, format == "vtr32");
+        write_pvd(prefix + "ChemoConc.pvd", vtr_datasets);
+        return;
+    }
+
+    write_chemo_csv(prefix + stem + ".csv", x, y, u);
+}
+
+
+// prefix of the files of level k of the output pyramid
+static string level_prefix(int k) {
+    return k == 0 ? string() : "L" + to_string(k) + "_";
+}
+
+
+// the snapshot at every level of the output pyramid, one .pvd index per level in level_datasets
+static void write_chemo_levels(const string &format, const string &prefix, const string &stem, double t, int step,
+                               const VectorXd &x, const MatrixXd &u,
+                               const vector<vector<pair<double, string>>> &level_datasets) {
+    const VectorXd y = VectorXd::LinSpaced(u.cols(), 0, u.cols() - 1);
+    write_chemo_snapshot(format, prefix, stem, t, step, x, y, u, level_datasets[0]);
+
+    VectorXd x_coarse, y_coarse;
+    MatrixXd u_coarse;
+    for (int k = 1; k < int(level_datasets.size()); k++) {
+        block_average(x, y, u, 1 << k, x_coarse, y_coarse, u_coarse);
+        write_chemo_snapshot(format, prefix + level_prefix(k), stem, t, step, x_coarse, y_coarse, u_coarse,
+                             level_datasets[k]);
+    }
+}
+
+
+// the cells in the order of their ids
+static vector<CellRecord> cell_records(const particle_type &particles) {
+    vector<CellRecord> cells(particles.size());
+    for (size_t id = 0; id < cells.size(); id++) {
+        const size_t i = particles.index_of(int(id));
+        CellRecord &cell = cells[id];
+        cell.id = particles.id(i);
+        cell.type = particles.type(i);
+        cell.chain = particles.chain(i);
+        cell.chain_type = particles.chain_type(i);
+        cell.attached_to_id = particles.attached_to_id(i);
+        cell.unused = 0;
+        cell.x = particles.position(i)[0];
+        cell.y = particles.position(i)[1];
+        cell.direction_x = particles.direction(i)[0];
+        cell.direction_y = particles.direction(i)[1];
+    }
+    return cells;
+}
+
+
+void Simulation::save() {
+
+    // save cell positions
+
+#if defined(HAVE_VTK) && defined(NC_USE_ABORIA)
+    Aboria::vtkWriteGrid((config.output_prefix + "Cells").c_str(), t, particles.aboria().get_grid(true));
+#endif
+
+    record_save();
+
+    if (config.async_output) {
+        save_in_background();
+        return;
+    }
+
+    if (config.cell_trajectory) {
+        append_cell_frame(config.output_prefix + "Cells.nct", t, counter, cell_records(particles));
+    }
+
+    // save chemoattractant concentration
+    write_chemo_levels(config.chemo_format, config.output_prefix, chemo_stem(t, counter), t, counter, Gamma, chemo,
+                       level_datasets());
+}
+
+
+/*
+ * adaptive saving
+ */
+
+bool Simulation::save_due() const {
+    if (config.save_freq <= 0) {
+        return false;
+    }
+    if (!config.adaptive_saving()) {
+        return counter % config.save_freq == 0;
+    }
+
+    const int since = counter - last_save;
+    if (since >= config.save_freq) {
+        return true;
+    }
+    if (since < config.save_min_interval) {
+        return false;
+    }
+
+    // the cheap changes first
+    if (config.save_front_change > 0 && abs(front() - saved_front) >= config.save_front_change) {
+        return true;
+    }
+
+    if (config.save_cell_change > 0) {
+        int changes = int(particles.size()) - int(saved_chain.size()); // cells that entered
+        for (size_t id = 0; id < saved_chain.size() && changes < config.save_cell_change; id++) {
+            changes += particles.chain(particles.index_of(int(id))) != saved_chain[id];
+        }
+        if (changes >= config.save_cell_change) {
+            return true;
+        }
+    }
+
+    if (config.save_chemo_change > 0) {
+        double change;
+        if (chemo_view) {
+            const Map<const MatrixXd, 0, Stride<Dynamic, Dynamic>> shared(
+                    chemo_view, length_x, length_y, Stride<Dynamic, Dynamic>(chemo_stride_y, chemo_stride_x));
+            change = (shared - saved_chemo).cwiseAbs().maxCoeff();
+        } else {
+            change = (chemo - saved_chemo).cwiseAbs().maxCoeff();
+        }
+        if (change >= config.save_chemo_change) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+double Simulation::front() const {
+    double x = 0;
+    for (size_t i = 0; i < particles.size(); i++) {
+        x = max(x, particles.position(i)[0]);
+    }
+    return x;
+}
+
+
+void Simulation::record_save() {
+    saves.push_back(counter);
+    set_save_baseline();
+}
+
+
+void Simulation::set_save_baseline() {
+    last_save = counter;
+
+    // only what the thresholds in use compare with
+    if (config.save_front_change > 0) {
+        saved_front = front();
+    }
+    if (config.save_cell_change > 0) {
+        saved_chain.resize(particles.size());
+        for (size_t id = 0; id < saved_chain.size(); id++) {
+            saved_chain[id] = particles.chain(particles.index_of(int(id)));
+        }
+    }
+    if (config.save_chemo_change > 0) {
+        saved_chemo = chemo;
+    }
+}
+
+
+string Simulation::chemo_stem(double time, int step) const {
+    string stem = "ChemoConc" + to_string(int(time));
+    if (config.adaptive_saving()) {
+        stem += "_" + to_string(step); // more than one save in a time unit
+    }
+    return stem;
+}
+
+
+/*
+ * saves in the output queue
+ */
+
+struct OutputOrder {
+    mutex m;
+    condition_variable turn;
+    long issued = 0; // saves queued
+    long next = 0; // the save that may be written now
+    string error; // of the first save that failed
+};
+
+
+void Simulation::save_in_background() {
+    if (!output_order) {
+        output_order = make_shared<OutputOrder>();
+    }
+
+    // copies, the simulation carries on while they are written
+    const shared_ptr<OutputOrder> order = output_order;
+    const long ticket = order->issued;
+    const string format = config.chemo_format;
+    const string prefix = config.output_prefix;
+    const double time = t;
+    const int step = counter;
+    const VectorXd x = Gamma;
+    const MatrixXd u = chemo;
+    const string stem = chemo_stem(t, counter);
+    const vector<vector<pair<double, string>>> datasets = level_datasets();
+    const bool with_cells = config.cell_trajectory;
+    const vector<CellRecord> cells = with_cells ? cell_records(particles) : vector<CellRecord>();
+
+    auto write = [=]() {
+        unique_lock<mutex> lock(order->m);
+        order->turn.wait(lock, [&]() { return order->next == ticket; });
+        lock.unlock();
+
+        string error;
+        try {
+            if (with_cells) {
+                append_cell_frame(prefix + "Cells.nct", time, step, cells);
+            }
+            write_chemo_levels(format, prefix, stem, time, step, x, u, datasets);
+        } catch (const exception &e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (order->error.empty()) {
+            order->error = error;
+        }
+        order->next++;
+        order->turn.notify_all();
+    };
+
+    const Backpressure backpressure = config.drop_output ? Backpressure::drop : Backpressure::block;
+    if (OutputQueue::shared().push(write, backpressure)) {
+        order->issued++;
+    } else {
+        saves.pop_back(); // not written
+        n_dropped++;
+    }
+}
+
+
+/*
+ * live view
+ */
+
+void Simulation::publish_live_view() {
+    live->begin();
+
+    Map<VectorXd>(live->gamma(), length_x) = Gamma;
+    Map<MatrixXd>(live->chemo(), length_x, length_y) = chemo;
+
+    LiveSummary summary;
+    summary.t = t;
+    summary.step = counter;
+    summary.cells = int(particles.size());
+    summary.front = front();
+
+    // the first cells by id, the summary counts all of them
+    LiveCell *cells = live->cells();
+    const int shown = min(int(particles.size()), live->max_cells());
+    for (size_t i = 0; i < particles.size(); i++) {
+        summary.leaders += particles.type(i) == 0;
+        summary.in_chains += particles.type(i) == 1 && particles.chain(i) > 0;
+        const int id = particles.id(i);
+        if (id < shown) {
+            cells[id].x = float(particles.position(i)[0]);
+            cells[id].y = float(particles.position(i)[1]);
+            cells[id].type = particles.type(i);
+            cells[id].chain = particles.chain(i);
+        }
+    }
+
+    live->publish(summary, shown);
+}
+
+
+/*
+ * telemetry
+ */
+
+TelemetrySample Simulation::telemetry_sample() const {
+    TelemetrySample sample;
+    sample.job = telemetry_job;
+    sample.seed = n_seed;
+    sample.t = t;
+    sample.final_time = config.final_time;
+    sample.step = counter;
+    sample.steps = config.number_of_steps();
+    sample.wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    sample.cells = int(particles.size());
+    sample.inserted = max(0, sample.cells - config.N);
+    for (size_t i = 0; i < particles.size(); i++) {
+        sample.detached += particles.type(i) == 1 && particles.chain(i) == 0;
+    }
+    sample.phase_seconds = phase_time;
+    sample.rss_bytes = resident_memory();
+    sample.finished = finished();
+    sample.timestamp = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+    return sample;
+}
+
+
+void Simulation::report_progress(chrono::steady_clock::time_point now) {
+    const double since = chrono::duration<double>(now - last_report).count();
+    if (since < config.telemetry_interval && !finished()) {
+        return;
+    }
+
+    TelemetrySample sample = telemetry_sample();
+    if (since > 0) {
+        sample.steps_per_second = (counter - last_report_step) / since;
+    }
+    if (sample.steps_per_second > 0) {
+        sample.eta_seconds = max(0, sample.steps - counter) / sample.steps_per_second;
+    }
+    telemetry->report(sample);
+
+    last_report = now;
+    last_report_step = counter;
+}
+
+
+void Simulation::wait_for_output() {
+    if (!output_order) {
+        return;
+    }
+    OutputOrder &order = *output_order;
+    unique_lock<mutex> lock(order.m);
+    order.turn.wait(lock, [&]() { return order.next == order.issued; });
+    const string error = order.error;
+    order.error.clear();
+    if (!error.empty()) {
+        throw runtime_error(error);
+    }
+}
+
+
+void write_chemo_csv(const string &path, const VectorXd &x, const MatrixXd &u) {
+    write_chemo_csv(path, x, VectorXd::LinSpaced(u.cols(), 0, u.cols() - 1), u);
+}
+
+
+void write_chemo_csv(const string &path, const VectorXd &x, const VectorXd &y, const MatrixXd &u) {
+
+    ofstream output(path);
+
+
+    output << "x, y, z, u" << "\n" << endl;
+
+
+    // x on the grown domain, y, z (zero, paraview needs three dimensions) and u, produced only now that they are saved
+    for (int i = 0; i < u.rows(); i++) {
+        for (int j = 0; j < u.cols(); j++) {
+            output << x(i) << ", " << y(j) << ", " << 0.0 << ", " << u(i, j) << ", ";
+            output << "\n" << endl;
+        }
+    }
+}
+
+
+vector<vector<pair<double, string>>> Simulation::level_datasets() const {
+    vector<vector<pair<double, string>>> datasets(size_t(config.chemo_levels));
+    if (config.chemo_format == "vtr" || config.chemo_format == "vtr32") {
+        for (int k = 0; k < config.chemo_levels; k++) {
+            datasets[k] = vtr_snapshots(level_prefix(k));
+        }
+    }
+    return datasets;
+}
+
+
+void Simulation::set_output_prefix(const string &prefix) {
+    if (prefix != config.output_prefix) {
+        earlier_prefixes.push_back(make_pair(counter, config.output_prefix));
+        config.output_prefix = prefix;
+    }
+}
+
+
+// the file name part of an output prefix
+static string prefix_name(const string &prefix) {
+    const size_t slash = prefix.rfind('/');
+    return slash == string::npos ? prefix : prefix.substr(slash + 1);
+}
+
+
+vector<pair<double, string>> Simulation::vtr_snapshots(const string &level) const {
+    // the saved timesteps so far, with t accumulated as step() does, and the prefix each was written with
+    vector<pair<double, string>> datasets;
+    double time = 0.0;
+    size_t earlier = 0;
+    for (int n = 1; n <= counter; n++) {
+        time = time + config.dt;
+        while (earlier < earlier_prefixes.size() && earlier_prefixes[earlier].first < n) {
+            earlier++;
+        }
+        if (binary_search(saves.begin(), saves.end(), n)) {
+            const string &prefix = earlier < earlier_prefixes.size() ? earlier_prefixes[earlier].second :
+                                                                       config.output_prefix;
+            const string file = prefix_name(prefix) + level + chemo_stem(time, n) + ".vtr";
+            if (!datasets.empty() && datasets.back().second == file) {
+                datasets.back().first = time; // overwritten by the later snapshot
+            } else {
+                datasets.push_back(make_pair(time, file));
+            }
+        }
+    }
+    return datasets;
+}
+
+
+/*
+ * return the density of cells in domain_partition parts of the domain
+ */
+
+VectorXi Simulation::density_profile() const {
+
+    const int domain_partition = int(Gamma(length_x - 1) / double(55)); // number of intervals of 50 \mu m
+
+
+    VectorXi proportions = VectorXi::Zero(
+            domain_partition); // integer with number of cells in particular part that plus one is proportions that are not in chains
+
+    double one_part = Gamma(length_x - 1) / double(domain_partition);
+
+
+    for (int i = 0; i < domain_partition; i++) {
+
+        for (int j = 0; j < particles.size(); j++) {
+            vdouble2 x = particles.position(j);
+            if (i * one_part < x[0] && x[0] < (i + 1) * one_part) {
+                proportions(i) += 1;
+            }
+        }
+
+    }
+
+    return proportions;
+}
+
+
+double Simulation::break_proportion() const {
+
+    int followers_not_in_chain = 0;
+
+    for (int i = 0; i < particles.size(); ++i) {
+        if (particles.chain(i) == 0) {
+            if (particles.type(i) == 1) {
+                followers_not_in_chain += 1; // add to coung
+            }
+        }
+    }
+
+    return double(followers_not_in_chain) / (double(particles.size() - config.N));
+}
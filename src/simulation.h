@@ -0,0 +1,393 @@
+/*
+ * IBM model for NC cells coupled to reaction-diffusion model for chemoattractant on a spatially non-uniformly growing
+ * domain, model described in SI McKinney et al. (2019).
+ *
+ * SimulationConfig holds the model parameters, Simulation one realisation of the model: the constructor initialises
+ * it, step() advances one timestep and the observers give the state, e.g. the density of cells along the domain that
+ * main() collects.
+ */
+
+#ifndef NC_SIMULATION_H
+#define NC_SIMULATION_H
+
+#include "numa_placement.h"
+#include "particles.h"
+#include "telemetry.h"
+
+#include <Eigen/Core>
+
+#include <array>
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+class GrowthTrajectory;
+
+class LiveViewPublisher;
+
+struct BackgroundWrite;
+
+struct OutputOrder;
+
+struct SimulationConfig {
+
+    bool first_part_grows = true; // an example with one part of the domain growing faster than the other part,
+    // this is necessary for domain growth parameter estimation. True if the first part of the domain grows faster,
+    // false if final part grows faster
+
+    double space_grid_controller = 100.0;
+    double domain_length = 3.42; // initial domain length
+    double domain_width = 1.2; // domain width, it does not grow
+    double final_time = 54; // number of timesteps, 1min - 0.05, now dt =0.01, for 18 hrss we have 54. (The cells
+    // enter domain at t=6 hrs,so they travel for 18 hrs untill t= 24hrs)
+    double final_length = 1014; // final length of the domain
+
+    // parameters for the dynamics of chemoattractant concentration
+
+    double D = 2.0; // \nu m^2/h diffusion coefficient
+    double dt = 0.01; // time step
+    double dx = 1.0; // space step in x direction
+    double dy = 1.0; // space step in y direction
+    double k_reac = 1.0; // reaction term
+
+    // cell parameters
+
+    double cell_radius = 7.5; // radius of a cell
+    int N = 5; // initial number of cells, all leaders
+    double l_filo_y = 27.5; // sensing radius, filopodia + cell radius
+    double l_filo_x = 27.5; // sensing radius, it will have to be rescaled when domain grows
+    double l_filo_max = 45; // this is the length when two cells which were previously in a chain become dettached
+    double speed_l = 0.14; // speed of a leader cell
+    double increase_fol_speed = 1.3; // a factor which determines how much faster follower cells are than leader cells
+    double eps = 1; // for phenotypic switching, the distance has to be that much higher
+    int same_dir = 0; // number of steps in the same direction +1, because if 0, then only one step in the same direction
+    bool random_pers = true; // persistent movement also when the cell moves randomly
+    double lam = 1.0; // /h chemoattractant internalisation
+    double diff_conc = 0.05; // relative chemoattractant increase a leader needs to move up the gradient
+
+    // strain rate, piecewise constant, two parts
+
+    double n_faster = 2.0; // 1 part n_faster times faster than the other part
+    double thetasmall = 1.0; // first thetasmall is growing faster/slower
+
+    // numerics and output
+
+    int reorder_freq = 200; // how many neighbour search updates between reordering the particle arrays
+    int save_freq = 100; // timesteps between saving cells and chemoattractant, 0 for no output
+    int checkpoint_freq = 0; // timesteps between checkpoints to output_prefix + "Checkpoint.bin", 0 for none
+    std::string output_prefix = ""; // prepended to the output file names, e.g. a directory
+    std::string growth_cache = ""; // directory of growth trajectories shared between runs (src/growth_cache.h), empty
+    // computes the growth every timestep
+    std::string chemo_format = "csv"; // chemoattractant snapshots: csv, or vtr (vtr32 with u in single precision),
+    // binary VTK rectilinear grids indexed by ChemoConc.pvd (src/vtk_output.h), or archive (archive_z compressed,
+    // archive_q16 also with u in 16 bits), all in the one file ChemoConc.nca (src/snapshot_archive.h)
+    int chemo_levels = 1; // levels of the chemoattractant output, level k > 0 averaged over blocks of 2^k x 2^k grid
+    // points (src/field_pyramid.h) and written in chemo_format with the file prefix L<k>_
+    bool cell_trajectory = false; // the cells of every save are appended to output_prefix + "Cells.nct"
+    // (src/cell_trajectory.h)
+    // adaptive saving, with any of the three changes below > 0: a save once one of the changes since the last save reaches
+    // its threshold, at least save_min_interval and at most save_freq timesteps after it
+    int save_min_interval = 10;
+    double save_chemo_change = 0; // largest change of the chemoattractant at a grid point
+    int save_cell_change = 0; // cells that entered, joined a chain or left one
+    double save_front_change = 0; // distance the foremost cell moved, \mu m
+    std::string live_view = ""; // name of a POSIX shared memory segment the state is published to (src/live_view.h),
+    // empty for none
+    int live_view_freq = 10; // timesteps between two publications to live_view
+    std::string telemetry = ""; // file the progress is reported to (src/telemetry.h), Prometheus text if it ends in
+    // .prom, JSON lines otherwise, empty for none
+    double telemetry_interval = 5; // seconds of wall time between two reports
+    bool async_output = false; // saves are written by the I/O threads of OutputQueue::shared() (src/output_queue.h)
+    bool drop_output = false; // with async_output, a save that finds the queue full is dropped instead of waited for
+
+
+    // derived sizes
+
+    int length_x() const { return int(domain_length * space_grid_controller); } // x size of the chemoattractant matrix
+
+    int length_y() const { return int(domain_width * space_grid_controller); } // y size of the chemoattractant matrix
+
+    double diameter() const { return 2 * cell_radius; }
+
+    bool adaptive_saving() const { return save_chemo_change > 0 || save_cell_change > 0 || save_front_change > 0; }
+
+    // number of steps until final_time, accumulating t the same way step() does
+    int number_of_steps() const;
+
+    // number of 55 \mu m intervals the domain is split into for the density of cells at the end of the simulation
+    int density_bins() const;
+
+
+    /*
+     * access to the numeric parameters by name (the member names above, bools are 0 or 1), for parameter grids and
+     * other places where the parameters come from outside, unknown names throw std::invalid_argument
+     */
+
+    static std::vector<std::string> parameter_names();
+
+    double parameter(const std::string &name) const;
+
+    void set_parameter(const std::string &name, double value);
+
+    // whether the parameter only changes what is written, e.g. save_freq, not the results of the simulation
+    static bool output_parameter(const std::string &name);
+};
+
+
+/*
+ * domain growth, shared with the other ways of running the model
+ */
+
+// strain rate of every grid column along x, piecewise constant in two parts
+Eigen::VectorXd strain_rate(const SimulationConfig &config);
+
+// Gamma_x at time t and its integral Gamma, the position of every grid column on the grown domain
+void growth_at(const Eigen::VectorXd &strain, double t, double dx, Eigen::VectorXd &Gamma_x, Eigen::VectorXd &Gamma);
+
+
+class Simulation {
+public:
+
+    static const int filo_number = 3; // number of filopodia sent
+
+    Simulation(const SimulationConfig &config, int n_seed);
+
+    // start again from the initial conditions with another seed, reusing the allocated memory
+    void reset(int n_seed);
+
+    // carry on from the current state with the random numbers of another seed: the order of the moves follows n_seed
+    // from the next timestep on, and the streams of the entering cells and the directions are seeded with it
+    void reseed(int n_seed);
+
+    // advance one timestep
+    void step();
+
+    // step until final_time
+    void run();
+
+    bool finished() const { return t >= config.final_time; }
+
+    // threads for the chemoattractant phases, may be changed between steps without changing the results
+    void set_threads(int n) { n_threads = n > 0 ? n : 1; }
+
+    int threads() const { return n_threads; }
+
+    // moves the chemoattractant grids to a NUMA node, the cells follow the thread that touches them first
+    void place_on_numa_node(int node, bool huge_pages);
+
+    // where the pages of the chemoattractant grids are, relative to a NUMA node
+    NumaPageCount numa_pages(int node) const;
+
+
+    /*
+     * checkpoints, the complete state including the random number generators, so that a simulation read back carries on
+     * bitwise as the one written. Every checkpoint_freq timesteps step() copies the state and writes it in the
+     * background, through a temporary file and a rename.
+     */
+
+    std::string checkpoint_path() const { return config.output_prefix + "Checkpoint.bin"; }
+
+    // throws std::runtime_error if the file cannot be written
+    void write_checkpoint(std::ostream &out) const;
+
+    void write_checkpoint(const std::string &path) const;
+
+    // carry on from a checkpoint, throws std::runtime_error if it cannot be read or was written by a simulation with
+    // other model parameters (the output ones may differ)
+    void read_checkpoint(std::istream &in);
+
+    void read_checkpoint(const std::string &path);
+
+    // waits for the checkpoint being written in the background, throws std::runtime_error if writing it failed
+    void wait_for_checkpoint();
+
+    // with async_output, waits until the saves queued so far are written, throws std::runtime_error if one failed;
+    // run() calls it at the end
+    void wait_for_output();
+
+    // saves dropped because the output queue was full
+    int dropped_saves() const { return n_dropped; }
+
+    // writes the outputs after prefix from now on, the .pvd index keeps the snapshots saved before under the names they
+    // were written with, so prefix should name the same directory
+    void set_output_prefix(const std::string &prefix);
+
+
+    /*
+     * telemetry
+     */
+
+    // the name of this simulation in the reports, s<seed> by default
+    void set_telemetry_job(const std::string &job) { telemetry_job = job; }
+
+    // wall time spent in each TelemetryPhase since the start
+    const std::array<double, n_phases> &phase_seconds() const { return phase_time; }
+
+    // progress, population and time shares now
+    TelemetrySample telemetry_sample() const;
+
+
+    /*
+     * observers
+     */
+
+    const SimulationConfig &configuration() const { return config; }
+
+    double time() const { return t; }
+
+    int step_count() const { return counter; }
+
+    const Eigen::MatrixXd &chemo_field() const { return chemo; }
+
+    const Eigen::VectorXd &gamma() const { return Gamma; }
+
+    const particle_type &cells() const { return particles; }
+
+    // number of cells in each of the config.density_bins() parts of the domain
+    Eigen::VectorXi density_profile() const;
+
+    // the proportion of followers that are not in a chain
+    double break_proportion() const;
+
+private:
+
+    friend class LockstepEnsemble;
+    friend class ForkedEnsemble;
+
+    void insert_cells();
+
+    void grow_domain();
+
+    // the cells move with the domain, Gamma_x and Gamma already at the new time
+    void move_with_domain();
+
+    void update_chemo();
+
+    // chemoattractant the cells sense, their own field unless it is shared with a LockstepEnsemble
+    double chemo_at(int i, int j) const {
+        return chemo_view ? chemo_view[i * chemo_stride_x + j * chemo_stride_y] : chemo(i, j);
+    }
+
+    void move_cells();
+
+    // whether this timestep is saved, every save_freq timesteps or as adaptive saving decides
+    bool save_due() const;
+
+    void save();
+
+    // position of the foremost cell
+    double front() const;
+
+    // the save of this timestep, and the state later changes are measured from
+    void record_save();
+
+    void set_save_baseline();
+
+    // ChemoConc<t> for the files of the snapshot at time and step, with the step for adaptive saving, which may save
+    // more than once in a time unit
+    std::string chemo_stem(double time, int step) const;
+
+    // the .vtr snapshots of the run up to now, (time, file name relative to the .pvd), of the pyramid level with
+    // the file prefix level
+    std::vector<std::pair<double, std::string>> vtr_snapshots(const std::string &level = "") const;
+
+    // the .pvd index of every level of the output pyramid, empty unless chemo_format is vtr
+    std::vector<std::vector<std::pair<double, std::string>>> level_datasets() const;
+
+    bool checkpoint_due() const { return config.checkpoint_freq > 0 && counter % config.checkpoint_freq == 0; }
+
+    bool live_view_due() const { return live && config.live_view_freq > 0 && counter % config.live_view_freq == 0; }
+
+    // copies the state and writes it to checkpoint_path() on another thread, after the previous checkpoint
+    void checkpoint_in_background();
+
+    // hands the snapshot to the output queue, in the order of the saves of this simulation
+    void save_in_background();
+
+    // copies the grids and the cells into the live view
+    void publish_live_view();
+
+    // reports telemetry_sample() if telemetry_interval has passed since the last report or the run finished
+    void report_progress(std::chrono::steady_clock::time_point now);
+
+    SimulationConfig config;
+    int n_seed;
+    int n_threads;
+
+    // derived parameters
+    int length_x;
+    int length_y;
+    double diameter;
+    double speed_f; // speed of a follower cell
+
+    double t; // time
+    int counter; // number of timesteps
+    int value; // value of the Gamma(value), where Gamma is close to a cell center
+    int count_dir; // this is to count the number of times the cell moved the same direction
+
+    // growth
+    Eigen::VectorXd strain;
+    Eigen::VectorXd Gamma_x;
+    Eigen::VectorXd Gamma;
+    Eigen::VectorXd Gamma_t;
+    Eigen::VectorXd Gamma_old;
+    std::shared_ptr<const GrowthTrajectory> growth; // the growth of every timestep, if cached
+
+    // chemoattractant
+    Eigen::MatrixXd chemo;
+    Eigen::MatrixXd chemo_new;
+    Eigen::MatrixXd intern;
+
+    // chemo(i, j) is chemo_view[i * chemo_stride_x + j * chemo_stride_y] if set
+    const double *chemo_view;
+    long chemo_stride_x;
+    long chemo_stride_y;
+
+    particle_type particles;
+
+    // random number generator for particles entering the domain, appearing at the start in x and uniformly in y
+    std::default_random_engine gen;
+    std::uniform_real_distribution<double> uniform;
+
+    // random number generator to obtain random number between 0 and 2*pi
+    std::default_random_engine gen1;
+    std::uniform_real_distribution<double> uniformpi;
+
+    std::shared_ptr<BackgroundWrite> checkpoint_writer; // the checkpoint being written, if any
+
+    std::shared_ptr<OutputOrder> output_order; // the saves in the output queue, if any
+    int n_dropped; // saves dropped because the output queue was full
+
+    std::shared_ptr<LiveViewPublisher> live; // if config.live_view is set
+
+    // telemetry
+    std::shared_ptr<Telemetry> telemetry; // if config.telemetry is set
+    std::string telemetry_job;
+    std::array<double, n_phases> phase_time;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point last_report;
+    int last_report_step;
+
+    // saving
+    std::vector<int> saves; // timesteps saved, in order
+    std::vector<std::pair<int, std::string>> earlier_prefixes; // (last timestep saved with it, output prefix), in order
+    int last_save;
+    double saved_front; // the state at the last save, for the thresholds of adaptive saving in use
+    std::vector<int> saved_chain; // by id
+    Eigen::MatrixXd saved_chemo;
+};
+
+
+// a chemoattractant snapshot in the csv layout of Simulation: x(i), j, 0 and u(i, j) for every grid point
+void write_chemo_csv(const std::string &path, const Eigen::VectorXd &x, const Eigen::MatrixXd &u);
+
+// with the y coordinates of the grid columns
+void write_chemo_csv(const std::string &path, const Eigen::VectorXd &x, const Eigen::VectorXd &y,
+                     const Eigen::MatrixXd &u);
+
+#endif //NC_SIMULATION_H
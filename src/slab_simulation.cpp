@@ -0,0 +1,852 @@
+#include "slab_simulation.h"
+#include "growth_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+using namespace Eigen;
+
+
+// largest index j with g(j) < x, clamped to the grid
+static int last_below(const VectorXd &g, double x) {
+    const int j = int(lower_bound(g.data(), g.data() + g.size(), x) - g.data()) - 1;
+    return min(max(j, 0), int(g.size()) - 1);
+}
+
+
+SlabSimulation::SlabSimulation(const SimulationConfig &config, int n_seed, MPI_Comm comm)
+        : config(config),
+          n_seed(n_seed),
+          comm(comm),
+          length_x(config.length_x()),
+          length_y(config.length_y()),
+          diameter(config.diameter()),
+          speed_f(config.increase_fol_speed * config.speed_l),
+          deposit_cutoff(8 * config.cell_radius),
+          interaction_range(max(max(config.l_filo_max, config.l_filo_x), config.l_filo_y) + config.diameter() + 1),
+          rebalance_every(100),
+          t(0.0),
+          counter(0),
+          next_id(config.N),
+          n_owned(0),
+          uniform(config.cell_radius, length_y - 1 - config.cell_radius),
+          uniformpi(0, 2 * M_PI) {
+
+    MPI_Comm_rank(comm, &my_rank);
+    MPI_Comm_size(comm, &n_ranks);
+
+    // wide enough for the deposit, the filopodia and the stencil
+    halo = int(ceil(max(max(deposit_cutoff, interaction_range), config.l_filo_x + 2))) + 1;
+
+    // growth
+    strain = strain_rate(config);
+    if (!config.growth_cache.empty()) {
+        growth = GrowthTrajectory::open(config, config.growth_cache);
+    }
+    Gamma_x = VectorXd::Ones(length_x);
+    Gamma = VectorXd::LinSpaced(length_x, 0, length_x - 1);
+    Gamma_old = Gamma;
+
+    if (inlet_columns() + (n_ranks - 1) * min_slab_width > length_x) {
+        throw runtime_error("SlabSimulation: " + to_string(n_ranks) + " ranks need " +
+                            to_string(inlet_columns() + (n_ranks - 1) * min_slab_width) + " grid columns, there are " +
+                            to_string(length_x));
+    }
+
+    // the initial leaders, as in Simulation::reset(), all at the inlet
+    const int N = config.N;
+    vector<int> column_cells(length_x, 0);
+    column_cells[column_of(config.cell_radius)] = N;
+    bounds = balanced_bounds(column_cells);
+
+    leaders.resize(N);
+    for (int i = 0; i < N; ++i) {
+        slab_cell c = slab_cell();
+        c.x[0] = config.cell_radius;
+        c.x[1] = (i + 1) * double(length_y - 1) / double(N) - 0.5 * double(length_y - 1) / double(N);
+        c.id = i;
+        if (owner_of_column(column_of(c.x[0])) == my_rank) {
+            cells.push_back(c);
+        }
+    }
+
+    // chemoattractant
+    chemo_first = window_begin(my_rank);
+    chemo.setOnes(window_end(my_rank) - chemo_first, length_y);
+    chemo_new.setOnes(slab_end() - slab_begin(), length_y);
+    intern.setZero(slab_end() - slab_begin(), length_y);
+    deposit.setZero(window_end(my_rank) - chemo_first, length_y);
+
+    // every rank its own streams
+    seed_seq directions{n_seed, my_rank, 1};
+    gen1.seed(directions);
+    seed_seq order{n_seed, my_rank, 2};
+    gen2.seed(order);
+}
+
+
+void SlabSimulation::run() {
+    while (!finished()) {
+        step();
+    }
+}
+
+
+void SlabSimulation::step() {
+
+    insert_cells();
+
+    t = t + config.dt;
+
+    counter = counter + 1;
+
+    grow_domain();
+
+    update_chemo();
+
+    exchange_leaders();
+
+    exchange_ghosts();
+
+    move_cells();
+
+    resolve_swaps_and_breaks();
+
+    migrate_cells();
+
+    if (rebalance_every > 0 && counter % rebalance_every == 0) {
+        rebalance();
+    }
+
+    if (config.save_freq > 0 && counter % config.save_freq == 0) {
+        save();
+    }
+}
+
+
+int SlabSimulation::column_of(double x) const {
+    return last_below(Gamma, x);
+}
+
+
+int SlabSimulation::owner_of_column(int column) const {
+    return int(upper_bound(bounds.begin(), bounds.end(), column) - bounds.begin()) - 1;
+}
+
+
+int SlabSimulation::inlet_columns() const {
+    return column_of(config.cell_radius + diameter) + 1;
+}
+
+
+// the rows [a0, a1) and [b0, b1) have in common
+static array<int, 2> overlap(int a0, int a1, int b0, int b1) {
+    return {{max(a0, b0), min(a1, b1)}};
+}
+
+
+void SlabSimulation::insert_cells() {
+
+    // cells enter at x = cell_radius, the first slab holds that and every cell they could overlap
+    if (my_rank != 0) {
+        return;
+    }
+
+    const double x = config.cell_radius;
+    const double y = uniform(gen);
+
+    for (const slab_cell &c : cells) {
+        if ((c.x[0] - x) * (c.x[0] - x) + (c.x[1] - y) * (c.x[1] - y) < diameter * diameter) {
+            return;
+        }
+    }
+
+    // our assumption that all new cells are followers
+    slab_cell c = slab_cell();
+    c.x[0] = x;
+    c.x[1] = y;
+    c.id = next_id++;
+    c.type = 1;
+    c.chain_type = -1;
+    c.attached_to_id = -1;
+    cells.push_back(c);
+}
+
+
+void SlabSimulation::grow_domain() {
+
+    if (growth && growth->covers(counter)) {
+        growth->load(counter, Gamma_x, Gamma);
+    } else {
+        growth_at(strain, t, config.dx, Gamma_x, Gamma);
+    }
+
+    // cells move with the part of the domain they are in
+    for (slab_cell &c : cells) {
+        const int value = last_below(Gamma_old, c.x[0]);
+        c.scaling = value;
+        c.x[0] += Gamma(value) - Gamma_old(value);
+    }
+
+    Gamma_old = Gamma;
+}
+
+
+void SlabSimulation::send_rows(const grid_type &source, int source_first, const row_ranges &send, grid_type &target,
+                               int target_first, const row_ranges &receive, bool add) const {
+
+    vector<int> send_counts(n_ranks), send_displacements(n_ranks), receive_counts(n_ranks),
+            receive_displacements(n_ranks);
+    int n_send = 0, n_receive = 0;
+    for (int q = 0; q < n_ranks; ++q) {
+        send_counts[q] = max(0, send[q][1] - send[q][0]) * length_y;
+        send_displacements[q] = n_send;
+        n_send += send_counts[q];
+        receive_counts[q] = max(0, receive[q][1] - receive[q][0]) * length_y;
+        receive_displacements[q] = n_receive;
+        n_receive += receive_counts[q];
+    }
+
+    vector<double> outgoing(n_send), incoming(n_receive);
+    for (int q = 0; q < n_ranks; ++q) {
+        if (send_counts[q] > 0) {
+            copy_n(source.data() + size_t(send[q][0] - source_first) * length_y, send_counts[q],
+                   outgoing.data() + send_displacements[q]);
+        }
+    }
+
+    MPI_Alltoallv(outgoing.data(), send_counts.data(), send_displacements.data(), MPI_DOUBLE,
+                  incoming.data(), receive_counts.data(), receive_displacements.data(), MPI_DOUBLE, comm);
+
+    for (int q = 0; q < n_ranks; ++q) {
+        if (receive_counts[q] == 0) {
+            continue;
+        }
+        const int rows = receive[q][1] - receive[q][0];
+        Map<grid_type> rows_of_target(target.data() + size_t(receive[q][0] - target_first) * length_y, rows,
+                                      length_y);
+        Map<const grid_type> received(incoming.data() + receive_displacements[q], rows, length_y);
+        if (add) {
+            rows_of_target += received;
+        } else {
+            rows_of_target = received;
+        }
+    }
+}
+
+
+void SlabSimulation::exchange_halos() {
+    row_ranges send(n_ranks, {{0, 0}}), receive(n_ranks, {{0, 0}});
+    for (int q = 0; q < n_ranks; ++q) {
+        if (q != my_rank) {
+            send[q] = overlap(slab_begin(), slab_end(), window_begin(q), window_end(q));
+            receive[q] = overlap(bounds[q], bounds[q + 1], window_begin(my_rank), window_end(my_rank));
+        }
+    }
+    send_rows(chemo, chemo_first, send, chemo, chemo_first, receive, false);
+}
+
+
+void SlabSimulation::update_chemo() {
+
+    const double cell_radius = config.cell_radius;
+    const double D = config.D;
+    const double dt = config.dt;
+    const double dx = config.dx;
+    const double dy = config.dy;
+    const double k_reac = config.k_reac;
+    const double lam = config.lam;
+
+    const int lo = slab_begin();
+    const int hi = slab_end();
+
+
+    // internalisation, deposited by every cell onto the rows of the window within deposit_cutoff
+    const int deposit_lo = chemo_first;
+    const int deposit_hi = window_end(my_rank);
+    deposit.setZero();
+
+    for (const slab_cell &c : cells) {
+        const int i0 = max(deposit_lo, column_of(c.x[0] - deposit_cutoff));
+        const int i1 = min(deposit_hi - 1, column_of(c.x[0] + deposit_cutoff) + 1);
+        const int j0 = max(0, int(floor(c.x[1] - deposit_cutoff)));
+        const int j1 = min(length_y - 1, int(ceil(c.x[1] + deposit_cutoff)));
+
+        for (int i = i0; i <= i1; i++) {
+            for (int j = j0; j <= j1; j++) {
+                deposit(i - deposit_lo, j) += exp(-((Gamma(i) - c.x[0]) * (Gamma(i) - c.x[0]) +
+                                                    (j - c.x[1]) * (j - c.x[1])) / (2 * cell_radius * cell_radius));
+            }
+        }
+    }
+
+    // what landed on the rows of other slabs is added there
+    row_ranges send(n_ranks, {{0, 0}}), receive(n_ranks, {{0, 0}});
+    for (int q = 0; q < n_ranks; ++q) {
+        if (q != my_rank) {
+            send[q] = overlap(deposit_lo, deposit_hi, bounds[q], bounds[q + 1]);
+            receive[q] = overlap(window_begin(q), window_end(q), lo, hi);
+        }
+    }
+    send_rows(deposit, deposit_lo, send, deposit, deposit_lo, receive, true);
+    intern += deposit.middleRows(lo - deposit_lo, hi - lo);
+
+
+    // inner coefficients, on the owned rows; c indexes the window, s the slab
+    for (int i = max(lo, 1); i < min(hi, length_x - 1); ++i) {
+        const int c = i - chemo_first;
+        const int s = i - lo;
+        for (int j = 1; j < length_y - 1; ++j) {
+
+            chemo_new(s, j) = dt * (D * 1.0 / (2.0 * dx * dx * Gamma_x(i)) *
+                                    ((1.0 / Gamma_x(i) + 1.0 / Gamma_x(i + 1)) * (chemo(c + 1, j) - chemo(c, j)) -
+                                     (chemo(c, j) - chemo(c - 1, j)) * (1.0 / Gamma_x(i) + 1.0 / Gamma_x(i - 1))) +
+                                    D * (chemo(c, j + 1) - 2 * chemo(c, j) + chemo(c, j - 1)) / (dy * dy) -
+                                    (chemo(c, j) * lam / (2 * M_PI * cell_radius * cell_radius)) * intern(s, j) +
+                                    chemo(c, j) * k_reac * (1 - chemo(c, j)) - strain(i) * chemo(c, j)) +
+                              chemo(c, j);
+        }
+    }
+
+    // boundaries
+    for (int j = 0; j < length_y; j++) {
+        if (lo == 0) {
+            chemo_new(0, j) = chemo_new(1, j);
+        }
+        if (hi == length_x) {
+            chemo_new(hi - 1 - lo, j) = chemo_new(hi - 2 - lo, j);
+        }
+    }
+
+    for (int s = 0; s < hi - lo; s++) {
+        chemo_new(s, 0) = chemo_new(s, 1);
+        chemo_new(s, length_y - 1) = chemo_new(s, length_y - 2);
+    }
+
+    chemo.middleRows(lo - chemo_first, hi - lo) = chemo_new;
+
+    // the halos for the next stencil and for the filopodia of cells near the edges
+    exchange_halos();
+}
+
+
+void SlabSimulation::exchange_leaders() {
+    const int N = config.N;
+
+    // each leader is owned by exactly one rank
+    vector<double> positions(2 * N, 0.0);
+    for (const slab_cell &c : cells) {
+        if (c.id < N) {
+            positions[2 * c.id] = c.x[0];
+            positions[2 * c.id + 1] = c.x[1];
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, positions.data(), 2 * N, MPI_DOUBLE, MPI_SUM, comm);
+
+    for (int i = 0; i < N; ++i) {
+        leaders[i] = Vector2d(positions[2 * i], positions[2 * i + 1]);
+    }
+}
+
+
+vector<SlabSimulation::slab_cell> SlabSimulation::send_cells(const vector<vector<slab_cell>> &to) const {
+    const int size = int(sizeof(slab_cell));
+
+    vector<int> send_counts(n_ranks), send_displacements(n_ranks, 0);
+    vector<slab_cell> send;
+    for (int r = 0; r < n_ranks; ++r) {
+        send_counts[r] = int(to[r].size()) * size;
+        send_displacements[r] = int(send.size()) * size;
+        send.insert(send.end(), to[r].begin(), to[r].end());
+    }
+
+    vector<int> receive_counts(n_ranks), receive_displacements(n_ranks, 0);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, receive_counts.data(), 1, MPI_INT, comm);
+    partial_sum(receive_counts.begin(), receive_counts.end() - 1, receive_displacements.begin() + 1);
+
+    vector<slab_cell> received((receive_displacements.back() + receive_counts.back()) / size);
+    MPI_Alltoallv(send.data(), send_counts.data(), send_displacements.data(), MPI_BYTE,
+                  received.data(), receive_counts.data(), receive_displacements.data(), MPI_BYTE, comm);
+    return received;
+}
+
+
+void SlabSimulation::exchange_ghosts() {
+
+    // the cells the cells of other slabs could see, the slabs within interaction_range of them
+    vector<vector<slab_cell>> to(n_ranks);
+    for (const slab_cell &c : cells) {
+        const int first = owner_of_column(column_of(c.x[0] - interaction_range));
+        const int last = owner_of_column(column_of(c.x[0] + interaction_range));
+        for (int q = first; q <= last; ++q) {
+            if (q != my_rank) {
+                to[q].push_back(c);
+            }
+        }
+    }
+
+    ghosts = send_cells(to);
+}
+
+
+void SlabSimulation::load_particles() {
+
+    particles = particle_type();
+    particle_ids.clear();
+    index_of_id.clear();
+
+    for (const vector<slab_cell> *group : {&cells, &ghosts}) {
+        for (const slab_cell &c : *group) {
+            const size_t k = particles.push_back(vdouble2(c.x[0], c.x[1]));
+            particles.radius(k) = config.cell_radius;
+            particles.direction(k) = vdouble2(c.direction[0], c.direction[1]);
+            particles.type(k) = c.type;
+            particles.chain(k) = c.chain;
+            particles.attached_to_id(k) = c.attached_to_id;
+            particles.chain_type(k) = c.chain_type;
+            particles.persistence_extent(k) = c.persistence_extent;
+            particles.same_dir_step(k) = c.same_dir_step;
+            particles.scaling(k) = c.scaling;
+            particle_ids.push_back(c.id);
+            index_of_id[c.id] = int(k);
+        }
+    }
+    n_owned = int(cells.size());
+
+    // never reordered, so local indices stay valid for the whole move
+    particles.init_neighbour_search(vdouble2(0, 0), 5 * vdouble2(double(length_x), double(length_y)), diameter);
+}
+
+
+void SlabSimulation::store_particles() {
+    for (int k = 0; k < n_owned; ++k) {
+        slab_cell &c = cells[k];
+        c.x[0] = particles.position(k)[0];
+        c.x[1] = particles.position(k)[1];
+        c.direction[0] = particles.direction(k)[0];
+        c.direction[1] = particles.direction(k)[1];
+        c.type = particles.type(k);
+        c.chain = particles.chain(k);
+        c.attached_to_id = particles.attached_to_id(k);
+        c.chain_type = particles.chain_type(k);
+        c.persistence_extent = particles.persistence_extent(k);
+        c.same_dir_step = particles.same_dir_step(k);
+        c.scaling = particles.scaling(k);
+    }
+}
+
+
+void SlabSimulation::move_cells() {
+
+    const double cell_radius = config.cell_radius;
+    const int N = config.N;
+    const double diff_conc = config.diff_conc;
+    const double l_filo_x_in = config.l_filo_x;
+    const double l_filo_y = config.l_filo_y;
+    const double l_filo_max = config.l_filo_max;
+    const double speed_l = config.speed_l;
+    const double increase_fol_speed = config.increase_fol_speed;
+    const double eps = config.eps;
+    const int same_dir = config.same_dir;
+    const bool random_pers = config.random_pers;
+
+    load_particles();
+    swaps.clear();
+    broken_chains.clear();
+
+    auto in_domain = [&](const vdouble2 &x) {
+        return x[0] > cell_radius && x[0] < Gamma(length_x - 1) && x[1] > cell_radius &&
+               x[1] < length_y - 1 - cell_radius;
+    };
+
+    // the owned cells in a random order
+    vector<int> order(n_owned);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), gen2);
+
+    for (int k : order) {
+
+        const vdouble2 x0 = particles.position(k);
+
+        // leaders
+        if (particles.type(k) == 0) {
+
+            const int s = particles.scaling(k);
+            const double x_in = s; // x coordinate in initial domain length scale
+            const double l_filo_x = s > 0 ? l_filo_x_in * s / Gamma(s) : l_filo_x_in;
+
+            // if it is still in the process of moving in the same direction
+            if (particles.persistence_extent(k) == 1) {
+                if (particles.is_free(x0, diameter, k) && in_domain(x0)) {
+                    particles.position(k) += particles.direction(k);
+                }
+                particles.same_dir_step(k) += 1;
+            }
+
+            // if a particle is not in a sequence of persistent steps
+            if (particles.persistence_extent(k) == 0) {
+
+                array<double, filo_number + 1> random_angle;
+                for (int a = 0; a < filo_number + 1; a++) {
+                    random_angle[a] = uniformpi(gen1);
+                }
+
+                const double old_chemo = chemo_at(int(round(x_in)), int(round(x0[1])));
+                array<double, filo_number> new_chemo;
+
+                for (int a = 0; a < filo_number; a++) {
+                    const double fx = round(x_in + sin(random_angle[a]) * l_filo_x);
+                    const double fy = round(x0[1] + cos(random_angle[a]) * l_filo_y);
+                    const bool outside = fx < 0 || fx > length_x - 1 || fy < 0 || fy > length_y - 1;
+                    new_chemo[a] = outside ? 0 : chemo_at(int(fx), int(fy));
+                }
+
+                int chemo_max_number = 0;
+                for (int a = 1; a < filo_number; a++) {
+                    if (new_chemo[chemo_max_number] < new_chemo[a]) {
+                        chemo_max_number = a;
+                    }
+                }
+
+                // up the gradient if it is steep enough, otherwise in the random direction
+                const bool up_gradient = (new_chemo[chemo_max_number] - old_chemo) / sqrt(old_chemo) > diff_conc;
+                const double angle = random_angle[up_gradient ? chemo_max_number : filo_number];
+                const vdouble2 step = speed_l * vdouble2(sin(angle), cos(angle));
+
+                if (particles.is_free(x0 + step, diameter, k) && in_domain(x0 + step)) {
+                    particles.position(k) += step;
+                    particles.direction(k) = step;
+                    if (same_dir > 0 && (up_gradient || random_pers)) {
+                        particles.persistence_extent(k) = 1;
+                    }
+                }
+            }
+
+            // check if it is not the end of moving in the same direction
+            if (particles.same_dir_step(k) > same_dir) {
+                particles.persistence_extent(k) = 0;
+                particles.same_dir_step(k) = 0;
+            }
+
+            if (particle_ids[k] < N) {
+                leaders[particle_ids[k]] = Vector2d(particles.position(k)[0], particles.position(k)[1]);
+            }
+        }
+
+
+        // followers
+        if (particles.type(k) == 1) {
+
+            // if the particle is part of the chain
+            if (particles.chain(k) > 0) {
+
+                // the cell it follows is owned or a ghost here unless it is too far away anyway
+                const auto followed = index_of_id.find(particles.attached_to_id(k));
+
+                if (followed == index_of_id.end() ||
+                    (particles.position(k) - particles.position(followed->second)).norm() > l_filo_max) {
+                    particles.chain(k) = 0;
+                    // dettach also all the cells that are behind it, here now and on the other ranks at the end
+                    for (int i = 0; i < n_owned; ++i) {
+                        if (particles.chain_type(i) == particles.chain_type(k)) {
+                            particles.chain(i) = 0;
+                        }
+                    }
+                    broken_chains.push_back(particles.chain_type(k));
+                }
+
+                if (followed != index_of_id.end()) {
+                    particles.direction(k) = particles.direction(followed->second);
+                    const vdouble2 x_chain = x0 + increase_fol_speed * particles.direction(k);
+                    if (particles.is_free(x_chain, diameter, k) && in_domain(x_chain)) {
+                        particles.position(k) = x_chain;
+                    }
+                }
+            }
+
+            // if the cell is not part of the chain
+            if (particles.chain(k) == 0) {
+
+                // a leader nearby
+                particles.for_each_neighbour(x0, l_filo_x_in, [&](size_t n) {
+                    if (particles.type(n) == 0) {
+                        particles.direction(k) = particles.direction(n);
+                        particles.chain(k) = 1;
+                        particles.attached_to_id(k) = particle_ids[n];
+                        particles.chain_type(k) = particle_ids[n];
+                    }
+                });
+
+                // or a follower in a chain
+                if (particles.chain(k) != 1) {
+                    particles.for_each_neighbour(x0, l_filo_y, [&](size_t n) {
+                        if (particles.type(n) == 1 && particles.chain(n) > 0 && int(n) != k) {
+                            particles.direction(k) = particles.direction(n);
+                            particles.chain(k) = particles.chain(n) + 1;
+                            particles.attached_to_id(k) = particle_ids[n];
+                            particles.chain_type(k) = particles.chain_type(n);
+                        }
+                    });
+                }
+
+                if (particles.chain(k) > 0) {
+                    const vdouble2 x_chain = x0 + increase_fol_speed * particles.direction(k);
+                    if (particles.is_free(x_chain, diameter, k) && in_domain(x_chain)) {
+                        particles.position(k) = x_chain;
+                    }
+                } else {
+                    // if it hasn't found anything close, move randomly
+                    const double random_angle = uniformpi(gen1);
+                    const vdouble2 step = speed_f * vdouble2(sin(random_angle), cos(random_angle));
+                    if (particles.is_free(x0 + step, diameter, k) && in_domain(x0 + step)) {
+                        particles.position(k) += step;
+                        particles.direction(k) = step;
+                    }
+                }
+            }
+
+            // a follower eps in front of the closest leader swaps places with it
+            const Vector2d x(particles.position(k)[0], particles.position(k)[1]);
+
+            int min_index = 0;
+            for (int i = 1; i < N; ++i) {
+                if (leaders[i][0] < leaders[min_index][0]) {
+                    min_index = i;
+                }
+            }
+
+            if (x[0] > leaders[min_index][0] + eps) {
+                int closest = 0;
+                for (int i = 1; i < N; ++i) {
+                    if ((x - leaders[i]).norm() < (x - leaders[closest]).norm()) {
+                        closest = i;
+                    }
+                }
+                if (x[0] > leaders[closest][0] + eps) {
+                    swaps.push_back(leader_swap{particle_ids[k], closest, {x[0], x[1]},
+                                                {leaders[closest][0], leaders[closest][1]}});
+                }
+            }
+        }
+    }
+
+    store_particles();
+}
+
+
+void SlabSimulation::resolve_swaps_and_breaks() {
+
+    // every rank sees all requests, in rank order
+    auto all_gather = [this](const void *data, int bytes, vector<char> &all) {
+        vector<int> counts(n_ranks), displacements(n_ranks, 0);
+        MPI_Allgather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+        partial_sum(counts.begin(), counts.end() - 1, displacements.begin() + 1);
+        all.resize(displacements.back() + counts.back());
+        MPI_Allgatherv(data, bytes, MPI_BYTE, all.data(), counts.data(), displacements.data(), MPI_BYTE, comm);
+    };
+
+    vector<char> all_swaps, all_breaks;
+    all_gather(swaps.data(), int(swaps.size() * sizeof(leader_swap)), all_swaps);
+    all_gather(broken_chains.data(), int(broken_chains.size() * sizeof(int)), all_breaks);
+
+    unordered_map<int, int> owned;
+    for (size_t c = 0; c < cells.size(); ++c) {
+        owned[cells[c].id] = int(c);
+    }
+
+    // a leader swaps with the first follower asking for it
+    vector<bool> taken(config.N, false);
+    const leader_swap *swap = reinterpret_cast<const leader_swap *>(all_swaps.data());
+    for (size_t s = 0; s < all_swaps.size() / sizeof(leader_swap); ++s, ++swap) {
+        if (taken[swap->leader_id]) {
+            continue;
+        }
+        taken[swap->leader_id] = true;
+
+        auto leader = owned.find(swap->leader_id);
+        if (leader != owned.end()) {
+            copy(swap->follower_x, swap->follower_x + 2, cells[leader->second].x);
+        }
+        auto follower = owned.find(swap->follower_id);
+        if (follower != owned.end()) {
+            copy(swap->leader_x, swap->leader_x + 2, cells[follower->second].x);
+        }
+    }
+
+    // chains that broke anywhere
+    const int *broken = reinterpret_cast<const int *>(all_breaks.data());
+    const unordered_set<int> broken_types(broken, broken + all_breaks.size() / sizeof(int));
+    for (slab_cell &c : cells) {
+        if (broken_types.count(c.chain_type)) {
+            c.chain = 0;
+        }
+    }
+}
+
+
+void SlabSimulation::migrate_cells() {
+    vector<vector<slab_cell>> leaving(n_ranks);
+    vector<slab_cell> staying;
+    for (const slab_cell &c : cells) {
+        const int owner = owner_of_column(column_of(c.x[0]));
+        (owner == my_rank ? staying : leaving[owner]).push_back(c);
+    }
+
+    const vector<slab_cell> arriving = send_cells(leaving);
+    staying.insert(staying.end(), arriving.begin(), arriving.end());
+    cells.swap(staying);
+}
+
+
+vector<int> SlabSimulation::balanced_bounds(const vector<int> &column_cells) const {
+
+    // work of a column: its grid row, and the deposit of each of its cells
+    const double deposit_width = 2 * deposit_cutoff + 1;
+    const double deposit_area = deposit_width * min(deposit_width, double(length_y));
+    vector<double> work(length_x + 1, 0.0); // prefix sums
+    for (int c = 0; c < length_x; ++c) {
+        work[c + 1] = work[c] + length_y + column_cells[c] * deposit_area;
+    }
+
+    vector<int> new_bounds(n_ranks + 1);
+    new_bounds[0] = 0;
+    new_bounds[n_ranks] = length_x;
+    for (int r = 0; r + 1 < n_ranks; ++r) {
+        // an even share of what the slabs before left over
+        const double target = work[new_bounds[r]] + (work[length_x] - work[new_bounds[r]]) / (n_ranks - r);
+        int end = new_bounds[r] + (r == 0 ? max(inlet_columns(), int(min_slab_width)) : min_slab_width);
+        const int last = length_x - min_slab_width * (n_ranks - 1 - r);
+        while (end < last && work[end] < target) {
+            ++end;
+        }
+        new_bounds[r + 1] = end;
+    }
+    return new_bounds;
+}
+
+
+void SlabSimulation::rebalance() {
+
+    // cells in every column
+    vector<int> column_cells(length_x, 0);
+    for (const slab_cell &c : cells) {
+        column_cells[column_of(c.x[0])] += 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, column_cells.data(), length_x, MPI_INT, MPI_SUM, comm);
+
+    const vector<int> old_bounds = bounds;
+    const int old_first = chemo_first;
+    bounds = balanced_bounds(column_cells);
+    if (bounds == old_bounds) {
+        return;
+    }
+
+    // the owned rows of the grids, only those that change owner go to another rank
+    row_ranges send(n_ranks), receive(n_ranks);
+    for (int q = 0; q < n_ranks; ++q) {
+        send[q] = overlap(old_bounds[my_rank], old_bounds[my_rank + 1], bounds[q], bounds[q + 1]);
+        receive[q] = overlap(old_bounds[q], old_bounds[q + 1], slab_begin(), slab_end());
+    }
+
+    chemo_first = window_begin(my_rank);
+    grid_type new_chemo(window_end(my_rank) - chemo_first, length_y);
+    send_rows(chemo, old_first, send, new_chemo, chemo_first, receive, false);
+    chemo.swap(new_chemo);
+
+    grid_type new_intern(slab_end() - slab_begin(), length_y);
+    send_rows(intern, old_bounds[my_rank], send, new_intern, slab_begin(), receive, false);
+    intern.swap(new_intern);
+
+    // written before they are read
+    chemo_new.resize(slab_end() - slab_begin(), length_y);
+    deposit.resize(window_end(my_rank) - chemo_first, length_y);
+
+    exchange_halos();
+    migrate_cells();
+}
+
+
+long SlabSimulation::total_cells() const {
+    long n = long(cells.size());
+    MPI_Allreduce(MPI_IN_PLACE, &n, 1, MPI_LONG, MPI_SUM, comm);
+    return n;
+}
+
+
+VectorXi SlabSimulation::density_profile() const {
+
+    const int domain_partition = int(Gamma(length_x - 1) / double(55)); // number of intervals of 50 \mu m
+
+    VectorXi proportions = VectorXi::Zero(domain_partition);
+
+    double one_part = Gamma(length_x - 1) / double(domain_partition);
+
+    for (int i = 0; i < domain_partition; i++) {
+        for (const slab_cell &c : cells) {
+            if (i * one_part < c.x[0] && c.x[0] < (i + 1) * one_part) {
+                proportions(i) += 1;
+            }
+        }
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, proportions.data(), domain_partition, MPI_INT, MPI_SUM, comm);
+    return proportions;
+}
+
+
+double SlabSimulation::break_proportion() const {
+
+    long counts[2] = {0, long(cells.size())}; // followers not in a chain, all cells
+    for (const slab_cell &c : cells) {
+        if (c.chain == 0 && c.type == 1) {
+            counts[0] += 1;
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_LONG, MPI_SUM, comm);
+
+    return double(counts[0]) / (double(counts[1] - config.N));
+}
+
+
+MatrixXd SlabSimulation::gather_chemo() const {
+    vector<int> counts(n_ranks), displacements(n_ranks);
+    for (int r = 0; r < n_ranks; ++r) {
+        counts[r] = (bounds[r + 1] - bounds[r]) * length_y;
+        displacements[r] = bounds[r] * length_y;
+    }
+
+    grid_type all;
+    if (my_rank == 0) {
+        all.resize(length_x, length_y);
+    }
+    MPI_Gatherv(chemo.data() + size_t(slab_begin() - chemo_first) * length_y, counts[my_rank], MPI_DOUBLE, all.data(),
+                counts.data(), displacements.data(), MPI_DOUBLE, 0, comm);
+
+    return all;
+}
+
+
+void SlabSimulation::save() {
+
+    const MatrixXd all = gather_chemo();
+    if (my_rank != 0) {
+        return;
+    }
+
+    // the format of Simulation::save()
+    ofstream output(config.output_prefix + "ChemoConc" + to_string(int(t)) + ".csv");
+
+    output << "x, y, z, u" << "\n" << endl;
+
+    for (int i = 0; i < length_x; i++) {
+        for (int j = 0; j < length_y; j++) {
+            output << Gamma(i) << ", " << j << ", " << 0 << ", " << all(i, j) << ", " << "\n" << endl;
+        }
+    }
+}
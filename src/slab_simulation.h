@@ -0,0 +1,253 @@
+/*
+ * The model split over MPI ranks in slabs of the reference grid along x, for domains and populations too large for one
+ * process.
+ *
+ * Rank r owns the grid columns [slab_begin(), slab_end()) and the cells whose position maps into them. A rank only
+ * stores part of the grids: the chemoattractant and the deposit on its window, the owned rows and halo_width() rows on
+ * either side (clipped to the domain), and the internalisation on the owned rows, so the memory per rank shrinks as
+ * ranks are added. Every timestep
+ *
+ *  - each rank deposits the internalisation of its cells onto the rows of its window within 8 cell radii of them, and
+ *    the rows that belong to other slabs are sent to their owners and added there (the deposit halo),
+ *  - the PDE is solved on the owned rows, and every rank receives the rows of its window from their owners, so that
+ *    the stencil and the filopodia of cells near the slab edge see current values,
+ *  - cells within the interaction range of another rank's slab are sent to it as ghosts, read but not moved there,
+ *  - the owned cells move by the rules of Simulation::move_cells(), and cells that crossed a slab boundary migrate to
+ *    their new owner.
+ * A window may reach over several slabs, the halos are exchanged with every rank whose slab it overlaps.
+ *
+ * Every rebalance_interval() timesteps the slab boundaries are moved so that every rank gets a similar share of the
+ * work, grid rows plus the internalisation of the cells in them, and only the rows and cells that change owner are
+ * sent. A cell's deposit costs more than a hundred grid rows, so while the cells are crowded at the start of the
+ * domain most ranks share the columns of the cells and the last rank owns the long empty rest of the grid. Slabs are at
+ * least two columns wide, and the first slab holds the columns within a cell diameter of the inlet at x = cell_radius,
+ * so that the entering cells are checked against all cells there; this limits the number of ranks to about length_x()
+ * / 2.
+ *
+ * The model is the same as Simulation's, but the realisations are not bitwise the same: every rank draws from its own
+ * random number streams, the internalisation is cut off at 8 cell radii, and a follower overtaking a leader swaps with
+ * it, and a chain that breaks detaches its cells, at the end of the timestep rather than immediately.
+ *
+ * All member functions are collective over the communicator unless noted.
+ */
+
+#ifndef NC_SLAB_SIMULATION_H
+#define NC_SLAB_SIMULATION_H
+
+#include "particles.h"
+#include "simulation.h"
+
+#include <Eigen/Core>
+#include <mpi.h>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+class SlabSimulation {
+public:
+
+    static const int filo_number = Simulation::filo_number;
+
+    static const int min_slab_width = 2; // the boundary conditions copy the neighbouring row of the same slab
+
+    // throws std::runtime_error on every rank if there are more ranks than slabs fit into the grid
+    SlabSimulation(const SimulationConfig &config, int n_seed, MPI_Comm comm = MPI_COMM_WORLD);
+
+    void step();
+
+    void run();
+
+    bool finished() const { return t >= config.final_time; }
+
+    // timesteps between two rebalancings, 0 never rebalances (local)
+    void set_rebalance_interval(int n) { rebalance_every = n; }
+
+    int rebalance_interval() const { return rebalance_every; }
+
+    // move the slab boundaries to even out the work now
+    void rebalance();
+
+
+    /*
+     * observers, local
+     */
+
+    const SimulationConfig &configuration() const { return config; }
+
+    double time() const { return t; }
+
+    int step_count() const { return counter; }
+
+    int rank() const { return my_rank; }
+
+    int ranks() const { return n_ranks; }
+
+    int slab_begin() const { return bounds[my_rank]; }
+
+    int slab_end() const { return bounds[my_rank + 1]; }
+
+    // rows on either side of the slab that are kept up to date
+    int halo_width() const { return halo; }
+
+    // cells owned by this rank
+    int local_cells() const { return int(cells.size()); }
+
+
+    /*
+     * observers, collective
+     */
+
+    long total_cells() const;
+
+    // as Simulation::density_profile(), the same on all ranks
+    Eigen::VectorXi density_profile() const;
+
+    // as Simulation::break_proportion(), the same on all ranks
+    double break_proportion() const;
+
+    // the whole chemoattractant field on rank 0, empty on the others
+    Eigen::MatrixXd gather_chemo() const;
+
+private:
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> grid_type; // a slab is contiguous
+
+    // everything about a cell, sent between ranks as bytes
+    struct slab_cell {
+        double x[2];
+        double direction[2];
+        int id;
+        int type;
+        int chain;
+        int attached_to_id;
+        int chain_type;
+        int persistence_extent;
+        int same_dir_step;
+        int scaling;
+    };
+
+    // [begin, end) global grid rows for every rank, empty if end <= begin
+    typedef std::vector<std::array<int, 2>> row_ranges;
+
+    // a follower that overtook a leader
+    struct leader_swap {
+        int follower_id;
+        int leader_id;
+        double follower_x[2];
+        double leader_x[2];
+    };
+
+    void insert_cells();
+
+    void grow_domain();
+
+    void update_chemo();
+
+    void exchange_leaders();
+
+    void exchange_ghosts();
+
+    void move_cells();
+
+    void resolve_swaps_and_breaks();
+
+    void migrate_cells();
+
+    void save();
+
+    // largest grid column whose position on the grown domain is left of x
+    int column_of(double x) const;
+
+    int owner_of_column(int column) const;
+
+    // the rows rank r keeps of the chemoattractant, its slab and the halos
+    int window_begin(int r) const { return std::max(0, bounds[r] - halo); }
+
+    int window_end(int r) const { return std::min(length_x, bounds[r + 1] + halo); }
+
+    // the columns within a cell diameter of the inlet, which the first slab holds
+    int inlet_columns() const;
+
+    // slab boundaries that share out the work of grid rows and cells, given the number of cells in every column
+    std::vector<int> balanced_bounds(const std::vector<int> &column_cells) const;
+
+    // rows of source, whose first row is global row source_first, to the other ranks: send[q] go to rank q, and
+    // receive[q] from rank q are placed into target, or added to it, whose first row is target_first
+    void send_rows(const grid_type &source, int source_first, const row_ranges &send, grid_type &target,
+                   int target_first, const row_ranges &receive, bool add) const;
+
+    // the rows of the window of chemo from their owners
+    void exchange_halos();
+
+    // to[q] to rank q, returns what the other ranks sent here
+    std::vector<slab_cell> send_cells(const std::vector<std::vector<slab_cell>> &to) const;
+
+    double chemo_at(int i, int j) const { return chemo(i - chemo_first, j); }
+
+    void load_particles();
+
+    void store_particles();
+
+    SimulationConfig config;
+    int n_seed;
+    MPI_Comm comm;
+    int my_rank;
+    int n_ranks;
+
+    int length_x;
+    int length_y;
+    double diameter;
+    double speed_f;
+    double deposit_cutoff; // distance beyond which a cell's internalisation is neglected
+    double interaction_range; // furthest a cell looks for others
+    int halo;
+    int rebalance_every;
+
+    std::vector<int> bounds; // rank r owns columns [bounds[r], bounds[r + 1])
+
+    double t;
+    int counter;
+    int next_id; // id of the next cell entering, only used on the rank owning column 0
+
+    // growth
+    Eigen::VectorXd strain;
+    Eigen::VectorXd Gamma_x;
+    Eigen::VectorXd Gamma;
+    Eigen::VectorXd Gamma_old;
+    std::shared_ptr<const GrowthTrajectory> growth; // the growth of every timestep, if cached
+
+    // chemoattractant and deposit on the window from global row chemo_first on, the others on the slab
+    int chemo_first;
+    grid_type chemo;
+    grid_type chemo_new;
+    grid_type intern;
+    grid_type deposit;
+
+    // owned cells between steps, and the ghosts of the neighbours
+    std::vector<slab_cell> cells;
+    std::vector<slab_cell> ghosts;
+
+    // owned cells followed by the ghosts while moving, local index -> cell
+    particle_type particles;
+    std::vector<int> particle_ids;
+    std::unordered_map<int, int> index_of_id;
+    int n_owned;
+
+    std::vector<Eigen::Vector2d> leaders; // positions of the leaders, ids 0 to N - 1, on every rank
+    std::vector<leader_swap> swaps;
+    std::vector<int> broken_chains;
+
+    std::default_random_engine gen; // y positions of entering cells
+    std::default_random_engine gen1; // directions
+    std::default_random_engine gen2; // order of the moves
+    std::uniform_real_distribution<double> uniform;
+    std::uniform_real_distribution<double> uniformpi;
+};
+
+#endif //NC_SLAB_SIMULATION_H
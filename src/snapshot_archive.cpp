@@ -0,0 +1,394 @@
+#include "snapshot_archive.h"
+#include "binary_io.h"
+#include "simulation.h"
+
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char archive_magic[16] = {'n', 'c', ' ', 'c', 'h', 'e', 'm', 'o', ' ', 'a', 'r', 'c', 'h', 'i', 'v', 'e'};
+static const uint32_t archive_version = 2; // 1 had no y coordinates, they were 0, 1, ...
+static const size_t archive_header_size = 32; // and the y coordinates from version 2 on
+
+static const uint32_t chunk_magic = 0x4e43534e;
+static const char index_tag[8] = "ncindex";
+
+// how the arrays of a chunk are stored
+static const uint32_t delta_shuffle = 1;
+static const uint32_t deflated = 2;
+static const uint32_t quantised16 = 4;
+
+
+struct chunk_header {
+    uint32_t magic;
+    uint32_t encoding;
+    double t;
+    int64_t step;
+    uint64_t x_bytes;
+    uint64_t u_bytes;
+    double u_min; // range of u, for quantised16
+    double u_max;
+};
+
+
+/*
+ * encoding of one array
+ */
+
+// delta coded and byte shuffled if encoding says so, then deflated if it says so
+template<typename U>
+static string pack(const vector<U> &values, uint32_t encoding) {
+    const size_t n = values.size();
+    string bytes(n * sizeof(U), '\0');
+
+    if (encoding & delta_shuffle) {
+        U previous = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const U d = U(values[i] - previous);
+            previous = values[i];
+            for (size_t b = 0; b < sizeof(U); ++b) {
+                bytes[b * n + i] = char((d >> (8 * b)) & 0xff);
+            }
+        }
+    } else if (n > 0) {
+        memcpy(&bytes[0], values.data(), bytes.size());
+    }
+
+    if (encoding & deflated) {
+#ifdef HAVE_ZLIB
+        uLongf size = compressBound(uLong(bytes.size()));
+        string packed(size, '\0');
+        if (compress2(reinterpret_cast<Bytef *>(&packed[0]), &size, reinterpret_cast<const Bytef *>(bytes.data()),
+                      uLong(bytes.size()), Z_DEFAULT_COMPRESSION) != Z_OK) {
+            throw runtime_error("cannot compress a snapshot");
+        }
+        packed.resize(size);
+        return packed;
+#endif
+    }
+    return bytes;
+}
+
+
+template<typename U>
+static vector<U> unpack(const string &packed, size_t n, uint32_t encoding) {
+    string bytes;
+    if (encoding & deflated) {
+#ifdef HAVE_ZLIB
+        bytes.resize(n * sizeof(U));
+        uLongf size = uLongf(bytes.size());
+        if (uncompress(reinterpret_cast<Bytef *>(&bytes[0]), &size, reinterpret_cast<const Bytef *>(packed.data()),
+                       uLong(packed.size())) != Z_OK || size != bytes.size()) {
+            throw runtime_error("a snapshot of the archive is damaged");
+        }
+#else
+        throw runtime_error("the archive is compressed with zlib, which this build does not have");
+#endif
+    } else {
+        bytes = packed;
+    }
+
+    if (bytes.size() != n * sizeof(U)) {
+        throw runtime_error("a snapshot of the archive is damaged");
+    }
+
+    vector<U> values(n);
+    if (encoding & delta_shuffle) {
+        U previous = 0;
+        for (size_t i = 0; i < n; ++i) {
+            U d = 0;
+            for (size_t b = 0; b < sizeof(U); ++b) {
+                d = U(d | U(U(static_cast<unsigned char>(bytes[b * n + i])) << (8 * b)));
+            }
+            previous = U(previous + d);
+            values[i] = previous;
+        }
+    } else if (n > 0) {
+        memcpy(values.data(), bytes.data(), bytes.size());
+    }
+    return values;
+}
+
+
+static vector<uint64_t> bits_of(const double *values, size_t n) {
+    vector<uint64_t> bits(n);
+    if (n > 0) {
+        memcpy(bits.data(), values, n * sizeof(double));
+    }
+    return bits;
+}
+
+
+/*
+ * the index
+ */
+
+// the grid, the index and where the next chunk goes, false if the stream does not hold an archive
+static bool load_index(istream &in, int &nx, int &ny, VectorXd &y, vector<SnapshotArchive::entry> &index,
+                       uint64_t &end) {
+    in.seekg(0, ios::end);
+    const uint64_t size = uint64_t(in.tellg());
+    in.seekg(0);
+
+    char magic[16];
+    uint32_t version = 0, length_x = 0, length_y = 0, reserved = 0;
+    in.read(magic, sizeof(magic));
+    read_binary(in, version);
+    read_binary(in, length_x);
+    read_binary(in, length_y);
+    read_binary(in, reserved);
+    if (!in || memcmp(magic, archive_magic, sizeof(magic)) != 0 || version < 1 || version > archive_version) {
+        return false;
+    }
+    nx = int(length_x);
+    ny = int(length_y);
+    index.clear();
+
+    uint64_t chunks = archive_header_size;
+    if (version >= 2) {
+        read_binary(in, y);
+        chunks += 2 * sizeof(int64_t) + uint64_t(y.size()) * sizeof(double); // rows, columns, values
+        if (!in || y.size() != ny) {
+            return false;
+        }
+    } else {
+        y = VectorXd::LinSpaced(ny, 0, ny - 1);
+    }
+
+    // the index at the end
+    const uint64_t footer = 2 * sizeof(uint64_t) + sizeof(index_tag);
+    if (size >= chunks + footer) {
+        uint64_t n = 0, offset = 0;
+        char tag[8];
+        in.seekg(streamoff(size - footer));
+        read_binary(in, n);
+        read_binary(in, offset);
+        in.read(tag, sizeof(tag));
+        if (in && memcmp(tag, index_tag, sizeof(tag)) == 0 && offset >= chunks &&
+            offset + n * sizeof(SnapshotArchive::entry) + footer == size) {
+            in.seekg(streamoff(offset));
+            index.resize(size_t(n));
+            in.read(reinterpret_cast<char *>(index.data()), streamsize(n * sizeof(SnapshotArchive::entry)));
+            if (in) {
+                end = offset;
+                return true;
+            }
+        }
+    }
+
+    // no usable index, walk the chunks
+    in.clear();
+    index.clear();
+    end = chunks;
+    for (;;) {
+        chunk_header chunk;
+        in.seekg(streamoff(end));
+        read_binary(in, chunk);
+        if (!in || chunk.magic != chunk_magic || end + sizeof(chunk) + chunk.x_bytes + chunk.u_bytes > size) {
+            break;
+        }
+        // a chunk appended after a restart replaces the later steps before it
+        while (!index.empty() && index.back().step >= chunk.step) {
+            index.pop_back();
+        }
+        index.push_back(SnapshotArchive::entry{chunk.t, chunk.step, end});
+        end += sizeof(chunk) + chunk.x_bytes + chunk.u_bytes;
+    }
+    in.clear();
+    return true;
+}
+
+
+void append_snapshot(const string &path, const ArchiveOptions &options, double t, int step, const VectorXd &x,
+                     const MatrixXd &u) {
+    append_snapshot(path, options, t, step, x, VectorXd::LinSpaced(u.cols(), 0, u.cols() - 1), u);
+}
+
+
+void append_snapshot(const string &path, const ArchiveOptions &options, double t, int step, const VectorXd &x,
+                     const VectorXd &y, const MatrixXd &u) {
+    if (u.rows() != x.size() || u.cols() != y.size()) {
+        throw invalid_argument("append_snapshot: u is " + to_string(u.rows()) + " x " + to_string(u.cols()) +
+                               ", the coordinates " + to_string(x.size()) + " x " + to_string(y.size()));
+    }
+
+    fstream file(path, ios::in | ios::out | ios::binary);
+    if (!file) {
+        ofstream(path, ios::binary);
+        file.open(path, ios::in | ios::out | ios::binary);
+    }
+    if (!file) {
+        throw runtime_error("cannot write the archive " + path);
+    }
+
+    int nx = 0, ny = 0;
+    VectorXd stored_y;
+    vector<SnapshotArchive::entry> index;
+    uint64_t end = 0;
+    file.seekg(0, ios::end);
+    if (file.tellg() == 0) {
+        nx = int(u.rows());
+        ny = int(u.cols());
+        file.seekp(0);
+        file.write(archive_magic, sizeof(archive_magic));
+        write_binary(file, archive_version);
+        write_binary(file, uint32_t(nx));
+        write_binary(file, uint32_t(ny));
+        write_binary(file, uint32_t(0));
+        write_binary(file, y);
+        end = uint64_t(file.tellp());
+    } else if (!load_index(file, nx, ny, stored_y, index, end)) {
+        throw runtime_error(path + " is not a snapshot archive");
+    }
+    if (nx != u.rows() || ny != u.cols()) {
+        throw runtime_error("the archive " + path + " holds a grid of " + to_string(nx) + " x " + to_string(ny));
+    }
+
+    // a step again, the run was restarted
+    while (!index.empty() && index.back().step >= step) {
+        index.pop_back();
+    }
+
+    // the chunk
+    chunk_header chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.magic = chunk_magic;
+    chunk.t = t;
+    chunk.step = step;
+
+    uint32_t array_encoding = 0;
+    if (options.compress) {
+        array_encoding |= delta_shuffle;
+#ifdef HAVE_ZLIB
+        array_encoding |= deflated;
+#endif
+    }
+    chunk.encoding = array_encoding | (options.quantise16 ? quantised16 : 0);
+
+    const string x_packed = pack(bits_of(x.data(), size_t(x.size())), array_encoding);
+    string u_packed;
+    if (options.quantise16) {
+        chunk.u_min = u.size() > 0 ? u.minCoeff() : 0;
+        chunk.u_max = u.size() > 0 ? u.maxCoeff() : 0;
+        const double scale = chunk.u_max > chunk.u_min ? 65535 / (chunk.u_max - chunk.u_min) : 0;
+        vector<uint16_t> q(size_t(u.size()));
+        for (size_t i = 0; i < q.size(); ++i) {
+            q[i] = uint16_t(lround((u.data()[i] - chunk.u_min) * scale));
+        }
+        u_packed = pack(q, array_encoding);
+    } else {
+        u_packed = pack(bits_of(u.data(), size_t(u.size())), array_encoding);
+    }
+    chunk.x_bytes = x_packed.size();
+    chunk.u_bytes = u_packed.size();
+
+    file.seekp(streamoff(end));
+    write_binary(file, chunk);
+    file.write(x_packed.data(), streamsize(x_packed.size()));
+    file.write(u_packed.data(), streamsize(u_packed.size()));
+
+    // the new index after it
+    index.push_back(SnapshotArchive::entry{t, step, end});
+    const uint64_t index_offset = end + sizeof(chunk) + x_packed.size() + u_packed.size();
+    file.write(reinterpret_cast<const char *>(index.data()), streamsize(index.size() * sizeof(index[0])));
+    write_binary(file, uint64_t(index.size()));
+    write_binary(file, index_offset);
+    file.write(index_tag, sizeof(index_tag));
+    const uint64_t size = uint64_t(file.tellp());
+
+    file.close();
+    if (!file || truncate(path.c_str(), off_t(size)) != 0) {
+        throw runtime_error("cannot write the archive " + path);
+    }
+}
+
+
+/*
+ * reading
+ */
+
+SnapshotArchive::SnapshotArchive(const string &path) : file(path), nx(0), ny(0) {
+    ifstream in(path, ios::binary);
+    uint64_t end = 0;
+    if (!in || !load_index(in, nx, ny, y_coordinates, index, end)) {
+        throw runtime_error(path + " is not a snapshot archive");
+    }
+}
+
+
+int SnapshotArchive::find(double t) const {
+    const auto after = upper_bound(index.begin(), index.end(), t,
+                                   [](double time, const entry &e) { return time < e.t; });
+    return after == index.begin() ? 0 : int(after - index.begin()) - 1;
+}
+
+
+void SnapshotArchive::read(int k, VectorXd &x, MatrixXd &u) const {
+    ifstream in(file, ios::binary);
+    in.seekg(streamoff(index[k].offset));
+
+    chunk_header chunk;
+    read_binary(in, chunk);
+    if (!in || chunk.magic != chunk_magic) {
+        throw runtime_error("a snapshot of the archive " + file + " is damaged");
+    }
+    string x_packed(chunk.x_bytes, '\0'), u_packed(chunk.u_bytes, '\0');
+    in.read(&x_packed[0], streamsize(x_packed.size()));
+    in.read(&u_packed[0], streamsize(u_packed.size()));
+    if (!in) {
+        throw runtime_error("a snapshot of the archive " + file + " is damaged");
+    }
+
+    const uint32_t array_encoding = chunk.encoding & (delta_shuffle | deflated);
+
+    const vector<uint64_t> x_bits = unpack<uint64_t>(x_packed, size_t(nx), array_encoding);
+    x.resize(nx);
+    memcpy(x.data(), x_bits.data(), x_bits.size() * sizeof(double));
+
+    u.resize(nx, ny);
+    if (chunk.encoding & quantised16) {
+        const vector<uint16_t> q = unpack<uint16_t>(u_packed, size_t(nx) * ny, array_encoding);
+        const double step_size = (chunk.u_max - chunk.u_min) / 65535;
+        for (size_t i = 0; i < q.size(); ++i) {
+            u.data()[i] = chunk.u_min + q[i] * step_size;
+        }
+    } else {
+        const vector<uint64_t> u_bits = unpack<uint64_t>(u_packed, size_t(nx) * ny, array_encoding);
+        memcpy(u.data(), u_bits.data(), u_bits.size() * sizeof(double));
+    }
+}
+
+
+int archive_to_csv(const string &archive, const string &output_prefix) {
+    const SnapshotArchive snapshots(archive);
+
+    // several snapshots in a time unit, as with adaptive saving, are told apart by their step, as Simulation does
+    bool by_step = false;
+    for (int k = 1; k < snapshots.size(); ++k) {
+        by_step = by_step || int(snapshots.time(k)) == int(snapshots.time(k - 1));
+    }
+
+    VectorXd x;
+    MatrixXd u;
+    for (int k = 0; k < snapshots.size(); ++k) {
+        snapshots.read(k, x, u);
+        string stem = "ChemoConc" + to_string(int(snapshots.time(k)));
+        if (by_step) {
+            stem += "_" + to_string(snapshots.step(k));
+        }
+        write_chemo_csv(output_prefix + stem + ".csv", x, snapshots.y(), u);
+    }
+    return snapshots.size();
+}
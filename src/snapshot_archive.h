@@ -0,0 +1,94 @@
+/*
+ * All chemoattractant snapshots of a run in one file, with an index, instead of one csv file per snapshot.
+ *
+ *     header     "nc chemo archive", version, length_x, length_y, y coordinates of the grid columns
+ *     snapshot   chunk header (time, step, encoding, sizes, range of u), x coordinates, u
+ *     ...
+ *     index      time, step and file offset of every snapshot, their number, the offset of the index, "ncindex"
+ *
+ * Snapshots are appended: the new chunk overwrites the old index and a new index follows it, so a reader finds any
+ * snapshot from the end of the file without parsing the others. If the index is damaged, e.g. by a crash while
+ * appending, it is rebuilt by walking the chunks from the start. Appending a step that is not after the last one, as
+ * after a restart from a checkpoint, drops the later snapshots from the index.
+ *
+ * Every chunk can be encoded on its own, so seeking never needs earlier snapshots:
+ *  - compress: each array is delta coded along the grid (differences of the bit patterns, so lossless), its bytes are
+ *    shuffled so that the k-th bytes of all values are together, and the result is deflated with zlib when it was
+ *    found (HAVE_ZLIB), otherwise stored shuffled,
+ *  - quantise16: u is stored as 16 bit integers spanning its range in the snapshot, which is lossy, the x coordinates
+ *    stay exact.
+ * Numbers are stored in the byte order of the machine, archives are read back on the same architecture.
+ */
+
+#ifndef NC_SNAPSHOT_ARCHIVE_H
+#define NC_SNAPSHOT_ARCHIVE_H
+
+#include <Eigen/Core>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct ArchiveOptions {
+    bool compress = false; // delta, byte shuffle and deflate, lossless
+    bool quantise16 = false; // u in 16 bits
+};
+
+
+// appends the snapshot u(i, j) at (x(i), y(j)) of timestep step to the archive at path, which is created if missing
+// with the y coordinates, throws std::runtime_error if it cannot be written or holds a grid of another size
+void append_snapshot(const std::string &path, const ArchiveOptions &options, double t, int step,
+                     const Eigen::VectorXd &x, const Eigen::VectorXd &y, const Eigen::MatrixXd &u);
+
+// with y(j) = j
+void append_snapshot(const std::string &path, const ArchiveOptions &options, double t, int step,
+                     const Eigen::VectorXd &x, const Eigen::MatrixXd &u);
+
+
+class SnapshotArchive {
+public:
+
+    struct entry {
+        double t;
+        std::int64_t step;
+        std::uint64_t offset;
+    };
+
+    // reads the index, throws std::runtime_error if path is not an archive
+    explicit SnapshotArchive(const std::string &path);
+
+    int size() const { return int(index.size()); }
+
+    int length_x() const { return nx; }
+
+    int length_y() const { return ny; }
+
+    // the y coordinates of the grid columns, the same for all snapshots
+    const Eigen::VectorXd &y() const { return y_coordinates; }
+
+    double time(int k) const { return index[k].t; }
+
+    int step(int k) const { return int(index[k].step); }
+
+    // the last snapshot at or before t, the first one if there is none
+    int find(double t) const;
+
+    // the x coordinates and the field of snapshot k, throws std::runtime_error if the chunk is damaged
+    void read(int k, Eigen::VectorXd &x, Eigen::MatrixXd &u) const;
+
+private:
+
+    std::string file;
+    int nx;
+    int ny;
+    Eigen::VectorXd y_coordinates;
+    std::vector<entry> index;
+};
+
+
+// writes every snapshot of an archive as output_prefix + ChemoConc<t>.csv, in the layout Simulation writes, or as
+// ChemoConc<t>_<step>.csv if two snapshots fall in one time unit, so that none overwrites another, returns how many
+int archive_to_csv(const std::string &archive, const std::string &output_prefix);
+
+#endif //NC_SNAPSHOT_ARCHIVE_H
@@ -0,0 +1,176 @@
+#include "soa_particles.h"
+#include "binary_io.h"
+
+
+SoaParticles::SoaParticles(size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        push_back(vdouble2::Zero());
+    }
+}
+
+
+void SoaParticles::init_neighbour_search(const vdouble2 &low, const vdouble2 &high, double bin_size) {
+    low_ = low;
+    inv_bin_size_ = 1.0 / bin_size;
+    for (int d = 0; d < 2; ++d) {
+        n_bins_[d] = std::max(1, int(std::ceil((high[d] - low[d]) * inv_bin_size_)));
+    }
+    searchable_ = true;
+    rebuild();
+}
+
+
+size_t SoaParticles::push_back(const vdouble2 &x) {
+    const size_t i = position_.size();
+
+    position_.push_back(x);
+    id_.push_back(int(i));
+    index_of_.push_back(int(i));
+    type_.push_back(0);
+    chain_.push_back(0);
+
+    cold_fields c;
+    c.direction = vdouble2::Zero();
+    c.radius = 0;
+    c.attached_to_id = 0;
+    c.chain_type = 0;
+    c.persistence_extent = 0;
+    c.same_dir_step = 0;
+    c.scaling = 0;
+    cold_.push_back(c);
+
+    return i;
+}
+
+
+void SoaParticles::update_positions() {
+    if (!searchable_) {
+        return;
+    }
+
+    if (reorder_interval_ > 0 && ++updates_since_reorder_ >= reorder_interval_) {
+        reorder();
+    } else {
+        rebuild();
+    }
+}
+
+
+// interleave the bits of the bin coordinates, x in the even and y in the odd bits
+unsigned int SoaParticles::morton_key(unsigned int ix, unsigned int iy) {
+    unsigned int key = 0;
+    for (int b = 0; b < 16; ++b) {
+        key |= ((ix >> b) & 1u) << (2 * b);
+        key |= ((iy >> b) & 1u) << (2 * b + 1);
+    }
+    return key;
+}
+
+
+template<typename T>
+void SoaParticles::permute(std::vector<T> &v) {
+    std::vector<T> sorted(v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        sorted[i] = v[order_[i]];
+    }
+    v.swap(sorted);
+}
+
+
+void SoaParticles::reorder() {
+    const int n = int(position_.size());
+
+    keys_.resize(n);
+    order_.resize(n);
+    for (int i = 0; i < n; ++i) {
+        keys_[i] = morton_key(unsigned(bin_coordinate(position_[i][0], 0)),
+                              unsigned(bin_coordinate(position_[i][1], 1)));
+        order_[i] = i;
+    }
+
+    // stable, so that cells in the same bin keep their relative order
+    std::stable_sort(order_.begin(), order_.end(), [this](int a, int b) { return keys_[a] < keys_[b]; });
+
+    permute(position_);
+    permute(id_);
+    permute(type_);
+    permute(chain_);
+    permute(cold_);
+
+    for (int i = 0; i < n; ++i) {
+        index_of_[id_[i]] = i;
+    }
+
+    updates_since_reorder_ = 0;
+    rebuild();
+}
+
+
+// counting sort of the cells into bins, keeps insertion order within a bin
+void SoaParticles::rebuild() {
+    const int n_bins = n_bins_[0] * n_bins_[1];
+    const int n = int(position_.size());
+
+    bin_start_.assign(n_bins + 1, 0);
+    bin_of_.resize(n);
+    bin_particles_.resize(n);
+
+    for (int i = 0; i < n; ++i) {
+        bin_of_[i] = bin_coordinate(position_[i][1], 1) * n_bins_[0] + bin_coordinate(position_[i][0], 0);
+        bin_start_[bin_of_[i] + 1] += 1;
+    }
+
+    for (int b = 0; b < n_bins; ++b) {
+        bin_start_[b + 1] += bin_start_[b];
+    }
+
+    bin_fill_.assign(bin_start_.begin(), bin_start_.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        bin_particles_[bin_fill_[bin_of_[i]]++] = i;
+    }
+
+    n_indexed_ = size_t(n);
+}
+
+
+void SoaParticles::write(std::ostream &out) const {
+    write_binary(out, position_);
+    write_binary(out, id_);
+    write_binary(out, type_);
+    write_binary(out, chain_);
+    write_binary(out, cold_);
+    write_binary(out, index_of_);
+    write_binary(out, reorder_interval_);
+    write_binary(out, updates_since_reorder_);
+    write_binary(out, searchable_);
+    write_binary(out, low_);
+    write_binary(out, inv_bin_size_);
+    write_binary(out, n_bins_);
+    write_binary(out, std::uint64_t(n_indexed_));
+    write_binary(out, bin_start_);
+    write_binary(out, bin_particles_);
+    write_binary(out, bin_of_);
+}
+
+
+void SoaParticles::read(std::istream &in) {
+    std::uint64_t n_indexed = 0;
+    read_binary(in, position_);
+    read_binary(in, id_);
+    read_binary(in, type_);
+    read_binary(in, chain_);
+    read_binary(in, cold_);
+    read_binary(in, index_of_);
+    read_binary(in, reorder_interval_);
+    read_binary(in, updates_since_reorder_);
+    read_binary(in, searchable_);
+    read_binary(in, low_);
+    read_binary(in, inv_bin_size_);
+    read_binary(in, n_bins_);
+    read_binary(in, n_indexed);
+    read_binary(in, bin_start_);
+    read_binary(in, bin_particles_);
+    read_binary(in, bin_of_);
+    n_indexed_ = size_t(n_indexed);
+    bin_fill_.assign(bin_start_.empty() ? 0 : bin_start_.size() - 1, 0);
+}
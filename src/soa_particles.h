@@ -0,0 +1,223 @@
+/*
+ * Built-in particle container for the NC cell model, an alternative to Aboria's Particles.
+ *
+ * Storage is a structure of arrays split into hot and cold fields. Hot fields (position, id, type, chain) are read
+ * inside every neighbour search and live in their own contiguous arrays. Cold fields are only touched for the cell
+ * that is currently moving, so they are kept together in one record per cell.
+ *
+ * Ids are dense: a cell gets the index it was inserted at as its id, and cells are never removed. Indices are not
+ * stable, every reorder_interval calls of update_positions() the arrays are sorted along a Morton (Z-order) curve of the
+ * search bins, so that cells close in space are close in memory. index_of(id) finds a cell after that, anything
+ * kept across update_positions() (attached_to_id, chain_type, leaders) has to be stored as an id.
+ *
+ * The neighbour search is a uniform cell list with bins of the size given to init_neighbour_search (the cell
+ * diameter in the model). Bins are rebuilt with a counting sort on update_positions(), cells pushed back since the last
+ * rebuild are scanned linearly, so queries always see every cell. As with Aboria, positions changed between two
+ * update_positions() calls are used as they are, only the binning may be out of date.
+ */
+
+#ifndef NC_SOA_PARTICLES_H
+#define NC_SOA_PARTICLES_H
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+
+class SoaParticles {
+public:
+
+    // unaligned, so that it can be stored in plain std::vector and in the cold record
+    typedef Eigen::Matrix<double, 2, 1, Eigen::DontAlign> vdouble2;
+
+    struct cold_fields {
+        vdouble2 direction; // stores the direction a particle moved
+        double radius;
+        int attached_to_id; // id of the cell it follows in a chain
+        int chain_type; // id of the leader at the front of the chain
+        int persistence_extent; // 1 if in a process of moving persistently
+        int same_dir_step; // number of steps made in the same direction
+        int scaling; // index of Gamma the position is scaled down to
+    };
+
+    explicit SoaParticles(size_t n = 0);
+
+    size_t size() const { return position_.size(); }
+
+    // the search covers [low, high], positions outside are put in the boundary bins
+    void init_neighbour_search(const vdouble2 &low, const vdouble2 &high, double bin_size);
+
+    // appends a cell at x with all other fields zero, returns its index
+    size_t push_back(const vdouble2 &x);
+
+    // rebuild the cell list after positions changed, and reorder the cells if it is time to
+    void update_positions();
+
+    // number of update_positions() calls between two reorderings, 0 never reorders
+    void set_reorder_interval(int n) { reorder_interval_ = n; }
+
+    // sort the cells along the Morton curve of the search bins now
+    void reorder();
+
+    size_t index_of(int id) const { return size_t(index_of_[id]); }
+
+    // everything, the search structure and the reordering countdown included, so that a container read back behaves
+    // bitwise the same as the one written
+    void write(std::ostream &out) const;
+
+    void read(std::istream &in);
+
+
+    // hot fields
+
+    vdouble2 &position(size_t i) { return position_[i]; }
+
+    const vdouble2 &position(size_t i) const { return position_[i]; }
+
+    int id(size_t i) const { return id_[i]; }
+
+    int &type(size_t i) { return type_[i]; }
+
+    int type(size_t i) const { return type_[i]; }
+
+    int &chain(size_t i) { return chain_[i]; }
+
+    int chain(size_t i) const { return chain_[i]; }
+
+    // cold fields
+
+    vdouble2 &direction(size_t i) { return cold_[i].direction; }
+
+    const vdouble2 &direction(size_t i) const { return cold_[i].direction; }
+
+    double &radius(size_t i) { return cold_[i].radius; }
+
+    int &attached_to_id(size_t i) { return cold_[i].attached_to_id; }
+
+    int attached_to_id(size_t i) const { return cold_[i].attached_to_id; }
+
+    int &chain_type(size_t i) { return cold_[i].chain_type; }
+
+    int chain_type(size_t i) const { return cold_[i].chain_type; }
+
+    int &persistence_extent(size_t i) { return cold_[i].persistence_extent; }
+
+    int &same_dir_step(size_t i) { return cold_[i].same_dir_step; }
+
+    int &scaling(size_t i) { return cold_[i].scaling; }
+
+    // the arrays in place, in the order of the indices, valid until the next push_back() or update_positions()
+
+    const vdouble2 *position_data() const { return position_.data(); }
+
+    const int *id_data() const { return id_.data(); }
+
+    const int *type_data() const { return type_.data(); }
+
+    const int *chain_data() const { return chain_.data(); }
+
+    const cold_fields *cold_data() const { return cold_.data(); }
+
+
+    /*
+     * neighbour search, the functors get the index of each cell closer than r to x
+     */
+
+    // calls f(index) for every neighbour
+    template<typename F>
+    void for_each_neighbour(const vdouble2 &x, double r, F f) const {
+        any_neighbour(x, r, [&f](size_t j) {
+            f(j);
+            return false;
+        });
+    }
+
+    // true if pred(index) holds for some neighbour, stops at the first one
+    template<typename Pred>
+    bool any_neighbour(const vdouble2 &x, double r, Pred pred) const;
+
+    // true if there is no cell other than the one at index self closer than r to x
+    bool is_free(const vdouble2 &x, double r, long self = -1) const {
+        return !any_neighbour(x, r, [self](size_t j) { return long(j) != self; });
+    }
+
+private:
+
+    int bin_coordinate(double x, int d) const {
+        int b = int(std::floor((x - low_[d]) * inv_bin_size_));
+        return std::min(std::max(b, 0), n_bins_[d] - 1);
+    }
+
+    void rebuild();
+
+    static unsigned int morton_key(unsigned int ix, unsigned int iy);
+
+    template<typename T>
+    void permute(std::vector<T> &v);
+
+    // hot
+    std::vector<vdouble2> position_;
+    std::vector<int> id_;
+    std::vector<int> type_;
+    std::vector<int> chain_;
+
+    // cold
+    std::vector<cold_fields> cold_;
+
+    std::vector<int> index_of_;
+
+    // Morton reordering
+    int reorder_interval_ = 0;
+    int updates_since_reorder_ = 0;
+    std::vector<unsigned int> keys_;
+    std::vector<int> order_;
+
+    // cell list, bin b holds bin_particles_[bin_start_[b]] to bin_particles_[bin_start_[b + 1] - 1]
+    bool searchable_ = false;
+    vdouble2 low_ = vdouble2::Zero();
+    double inv_bin_size_ = 1.0;
+    int n_bins_[2] = {1, 1};
+    size_t n_indexed_ = 0; // cells inserted after the last rebuild are not in the bins
+    std::vector<int> bin_start_;
+    std::vector<int> bin_particles_;
+    std::vector<int> bin_of_;
+    std::vector<int> bin_fill_;
+};
+
+
+template<typename Pred>
+bool SoaParticles::any_neighbour(const vdouble2 &x, double r, Pred pred) const {
+    const double r2 = r * r;
+
+    if (searchable_) {
+        const int ix0 = bin_coordinate(x[0] - r, 0), ix1 = bin_coordinate(x[0] + r, 0);
+        const int iy0 = bin_coordinate(x[1] - r, 1), iy1 = bin_coordinate(x[1] + r, 1);
+
+        for (int iy = iy0; iy <= iy1; ++iy) {
+            for (int ix = ix0; ix <= ix1; ++ix) {
+                const int b = iy * n_bins_[0] + ix;
+                for (int k = bin_start_[b]; k < bin_start_[b + 1]; ++k) {
+                    const int j = bin_particles_[k];
+                    if ((position_[j] - x).squaredNorm() < r2 && pred(size_t(j))) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    // everything not in the bins yet
+    for (size_t j = searchable_ ? n_indexed_ : 0; j < position_.size(); ++j) {
+        if ((position_[j] - x).squaredNorm() < r2 && pred(j)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif //NC_SOA_PARTICLES_H
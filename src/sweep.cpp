@@ -0,0 +1,248 @@
+#include "sweep.h"
+#include "code_version.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace Eigen;
+
+
+vector<SimulationConfig> parameter_grid(const SimulationConfig &base, const vector<parameter_axis> &axes) {
+    vector<SimulationConfig> grid(1, base);
+
+    for (const parameter_axis &axis : axes) {
+        vector<SimulationConfig> next;
+        for (const SimulationConfig &config : grid) {
+            for (double value : axis.second) {
+                next.push_back(config);
+                next.back().set_parameter(axis.first, value);
+            }
+        }
+        grid.swap(next);
+    }
+
+    return grid;
+}
+
+
+Sweep::Sweep(const vector<SimulationConfig> &parameter_sets, int seeds)
+        : sets(parameter_sets), n_seeds(seeds), results(parameter_sets.size()),
+          result_mutexes(new mutex[parameter_sets.size()]) {
+}
+
+
+double Sweep::expected_cost(const SimulationConfig &config) {
+    return double(config.number_of_steps()) * config.length_x() * config.length_y();
+}
+
+
+vector<SweepJob> Sweep::jobs() const {
+    vector<SweepJob> all;
+    for (int p = 0; p < int(sets.size()); ++p) {
+        const double cost = expected_cost(sets[p]);
+        for (int seed = 0; seed < n_seeds; ++seed) {
+            all.push_back(SweepJob{p, seed, cost});
+        }
+    }
+
+    stable_sort(all.begin(), all.end(), [](const SweepJob &a, const SweepJob &b) {
+        return a.expected_cost > b.expected_cost;
+    });
+
+    return all;
+}
+
+
+int Sweep::density_bins() const {
+    int bins = 0;
+    for (const SimulationConfig &config : sets) {
+        bins = max(bins, config.density_bins());
+    }
+    return bins;
+}
+
+
+void Sweep::run(int n_threads, const string &results_path) {
+
+    for (size_t p = 0; p < sets.size(); ++p) {
+        results[p] = SweepResult();
+        results[p].stats = EnsembleStats(stats_options);
+    }
+
+    if (!results_path.empty()) {
+        output.reset(new ofstream(results_path));
+        if (!*output) {
+            throw runtime_error("cannot write sweep results to " + results_path);
+        }
+        *output << "parameter, seed, break proportion, density" << endl;
+    }
+
+    n_cache_hits = 0;
+
+    // jobs finished by an earlier run of this sweep
+    set<pair<int, int>> finished;
+    n_resumed = 0;
+    if (!journal_path.empty()) {
+        journal.reset(new SweepJournal(journal_path, identity()));
+        for (const JournalEntry &entry : journal->entries()) {
+            if (entry.parameter >= 0 && entry.parameter < int(sets.size()) && entry.seed >= 0 && entry.seed < n_seeds) {
+                EnsembleStats job_stats(stats_options);
+                job_stats.add_result(entry.density, entry.break_proportion);
+                record(SweepJob{entry.parameter, entry.seed, 0}, entry.density, entry.break_proportion, job_stats,
+                       true);
+                finished.insert(make_pair(entry.parameter, entry.seed));
+            }
+        }
+        n_resumed = int(finished.size());
+    }
+
+    vector<WorkStealingPool::task_type> tasks;
+    for (const SweepJob &job : jobs()) {
+        if (finished.count(make_pair(job.parameter, job.seed)) == 0) {
+            tasks.push_back(bind(&Sweep::run_job, this, job));
+        }
+    }
+
+    scheduler.reset(new ThreadScheduler(n_threads));
+    numa_report = NumaPageCount();
+
+    WorkStealingPool pool(scheduler->concurrency(int(tasks.size())));
+    pool.run(move(tasks));
+
+    if (numa_options.pin) {
+        pin_to_numa_node(-1); // the calling thread was worker 0
+    }
+
+    scheduler.reset();
+    output.reset();
+    journal.reset();
+}
+
+
+string Sweep::identity() const {
+    ostringstream grid;
+    grid.precision(numeric_limits<double>::max_digits10);
+    grid << n_seeds;
+    for (const SimulationConfig &config : sets) {
+        for (const string &name : SimulationConfig::parameter_names()) {
+            if (!SimulationConfig::output_parameter(name)) {
+                grid << " " << config.parameter(name);
+            }
+        }
+    }
+    return string("code ") + code_version() + " grid " + hex_string(fnv1a(grid.str()));
+}
+
+
+void Sweep::set_result_cache(const string &directory, size_t max_bytes) {
+    cache.reset(new ResultCache(directory, max_bytes));
+}
+
+
+void Sweep::run_job(const SweepJob &job) {
+
+    // a job that saves snapshots is run even if its result is cached, so that they are written
+    const bool use_cache = cache && stats_options.chemo_every == 0;
+    if (use_cache && sets[job.parameter].save_freq == 0) {
+        CachedResult cached;
+        if (cache->lookup(sets[job.parameter], job.seed, cached)) {
+            EnsembleStats job_stats(stats_options);
+            job_stats.add_result(cached.density, cached.break_proportion);
+            record(job, cached.density, cached.break_proportion, job_stats, false);
+            n_cache_hits += 1;
+            return;
+        }
+    }
+
+    SimulationConfig config = sets[job.parameter];
+
+    // keep the snapshots of different jobs apart
+    if (config.save_freq > 0 && sets.size() * n_seeds > 1) {
+        config.output_prefix += "p" + to_string(job.parameter) + "_s" + to_string(job.seed) + "_";
+    }
+
+    EnsembleStats job_stats(stats_options);
+
+    const double work_per_step = double(config.length_x()) * config.length_y();
+    const int steps = config.number_of_steps();
+
+    // leaves the scheduler however the job ends
+    struct scheduler_slot {
+        ThreadScheduler &scheduler;
+        int slot;
+        ~scheduler_slot() { scheduler.leave(slot); }
+    } slot{*scheduler, scheduler->enter(steps * work_per_step, scheduler->max_threads(config))};
+
+    // pinned before the simulation allocates its fields, so that they are first touched on the node
+    int node = -1;
+    if (numa_options.pin && numa_placement_available()) {
+        node = WorkStealingPool::current_worker() % numa_placement_nodes();
+        pin_to_numa_node(node);
+    }
+
+    Simulation simulation(config, job.seed);
+    simulation.set_telemetry_job("p" + to_string(job.parameter) + "_s" + to_string(job.seed));
+    if (node >= 0) {
+        simulation.place_on_numa_node(node, numa_options.huge_pages);
+    }
+
+    while (!simulation.finished()) {
+        if (simulation.step_count() % rebalance_every == 0) {
+            const double remaining = (steps - simulation.step_count()) * work_per_step;
+            simulation.set_threads(scheduler->update(slot.slot, remaining));
+        }
+        simulation.step();
+        if (stats_options.chemo_every > 0 && simulation.step_count() % stats_options.chemo_every == 0) {
+            job_stats.add_chemo(simulation.step_count(), simulation.chemo_field());
+        }
+    }
+    simulation.wait_for_output();
+
+    const VectorXi density = simulation.density_profile();
+    const double pro_break = simulation.break_proportion();
+    job_stats.add_result(density, pro_break);
+
+    if (use_cache) {
+        cache->store(sets[job.parameter], job.seed, pro_break, density);
+    }
+
+    if (node >= 0) {
+        const NumaPageCount pages = simulation.numa_pages(node);
+        lock_guard<mutex> lock(numa_mutex);
+        numa_report += pages;
+    }
+
+    record(job, density, pro_break, job_stats, false);
+}
+
+
+void Sweep::record(const SweepJob &job, const VectorXi &density, double pro_break, const EnsembleStats &job_stats,
+                   bool from_journal) {
+    {
+        lock_guard<mutex> lock(result_mutexes[job.parameter]);
+        SweepResult &result = results[job.parameter];
+        result.completed += 1;
+        result.stats.merge(job_stats);
+    }
+
+    if (output) {
+        lock_guard<mutex> lock(output_mutex);
+        *output << job.parameter << ", " << job.seed << ", " << pro_break;
+        for (int i = 0; i < density.size(); ++i) {
+            *output << ", " << density(i);
+        }
+        *output << endl; // flushed, so that finished jobs are on disk
+    }
+
+    if (journal && !from_journal) {
+        journal->append(job.parameter, job.seed, pro_break, density);
+    }
+}
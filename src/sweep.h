@@ -0,0 +1,156 @@
+/*
+ * Parameter x seed sweeps.
+ *
+ * A sweep runs every (parameter set, seed) pair as one job on a WorkStealingPool, longest expected job first. Each
+ * job collects its own EnsembleStats, which are merged into the statistics of its parameter set under that set's lock,
+ * so memory does not grow with the number of seeds. If a results file is given, every finished job is also written to
+ * it straight away, one line per job:
+ *
+ *     parameter, seed, break proportion, cells in each part of the domain ...
+ *
+ * The cores are shared out by a ThreadScheduler: one simulation per core while there are enough jobs, and, as the
+ * sweep drains, the freed cores go to the chemoattractant phases of the simulations still running. Those check their
+ * share every rebalance_every timesteps.
+ *
+ * With a result cache set, a job whose parameters, seed and code version were run before, by this or any other sweep
+ * or script sharing the cache, takes its result from there instead of simulating. Parameters that only change the
+ * output are not part of the key, and jobs that save snapshots (save_freq > 0) are always run, their results stored.
+ *
+ * With a journal set, every finished job is also recorded there, and a sweep that was interrupted picks up where it
+ * stopped when it is run again.
+ *
+ * With NUMA pinning on, worker w of the sweep runs on node w modulo the number of nodes, so that a simulation, its
+ * OpenMP threads and its fields stay on one node. numa_pages() then adds up where the grids of every job were at its
+ * end.
+ */
+
+#ifndef NC_SWEEP_H
+#define NC_SWEEP_H
+
+#include "ensemble_stats.h"
+#include "numa_placement.h"
+#include "result_cache.h"
+#include "simulation.h"
+#include "sweep_journal.h"
+#include "thread_scheduler.h"
+
+#include <Eigen/Core>
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// one axis of a parameter grid, a SimulationConfig parameter name and its values
+typedef std::pair<std::string, std::vector<double>> parameter_axis;
+
+// every combination of the axis values applied to base, the last axis varying fastest
+std::vector<SimulationConfig> parameter_grid(const SimulationConfig &base, const std::vector<parameter_axis> &axes);
+
+
+struct SweepJob {
+    int parameter; // index into the parameter sets
+    int seed;
+    double expected_cost;
+};
+
+
+// statistics over the seeds of one parameter set
+struct SweepResult {
+    int completed = 0;
+    EnsembleStats stats;
+};
+
+
+class Sweep {
+public:
+
+    static const int rebalance_every = 100; // timesteps between a job's checks of its number of threads
+
+    Sweep(const std::vector<SimulationConfig> &parameter_sets, int seeds);
+
+    // relative cost of one simulation, timesteps times grid size
+    static double expected_cost(const SimulationConfig &config);
+
+    // all jobs, longest expected first
+    std::vector<SweepJob> jobs() const;
+
+    // what is collected besides the density and break proportion, set before run()
+    void set_statistics(const EnsembleStatsOptions &options) { stats_options = options; }
+
+    // NUMA placement of the simulations, set before run()
+    void set_numa(const NumaOptions &options) { numa_options = options; }
+
+    // keep a journal of the finished jobs at path (src/sweep_journal.h), set before run(): run() then skips the jobs a
+    // run of the same parameter sets, seeds and code version finished before, and takes their results from it
+    void set_journal(const std::string &path) { journal_path = path; }
+
+    // look every job up in a result cache (src/result_cache.h) of at most max_bytes first, and store the results of
+    // the jobs that ran there, set before run(); not used when chemoattractant snapshots are collected, and jobs
+    // that save snapshots only store their results
+    void set_result_cache(const std::string &directory, size_t max_bytes);
+
+    // runs all jobs on n_threads cores, streaming each job's result to results_path if it is not empty
+    void run(int n_threads, const std::string &results_path = "");
+
+    // jobs of the last run() that were taken from the journal instead of run
+    int resumed() const { return n_resumed; }
+
+    // jobs of the last run() whose results came from the result cache
+    int cache_hits() const { return n_cache_hits; }
+
+    // what a journal's results belong to: the code version and a hash of the parameter sets, without the output
+    // parameters, and the number of seeds
+    std::string identity() const;
+
+    const std::vector<SimulationConfig> &parameter_sets() const { return sets; }
+
+    int seeds() const { return n_seeds; }
+
+    // the statistics, safe to read once run() returned
+    const SweepResult &result(int parameter) const { return results[parameter]; }
+
+    // largest density_bins() over the parameter sets
+    int density_bins() const;
+
+    // pages of the grids on their simulation's node and elsewhere, summed over the jobs of the last run()
+    const NumaPageCount &numa_pages() const { return numa_report; }
+
+private:
+
+    void run_job(const SweepJob &job);
+
+    // adds a finished job to the statistics, the results file and the journal
+    void record(const SweepJob &job, const Eigen::VectorXi &density, double pro_break, const EnsembleStats &job_stats,
+                bool from_journal);
+
+    std::vector<SimulationConfig> sets;
+    int n_seeds;
+    EnsembleStatsOptions stats_options;
+    NumaOptions numa_options;
+
+    std::vector<SweepResult> results;
+    std::unique_ptr<std::mutex[]> result_mutexes;
+
+    std::mutex output_mutex;
+    std::unique_ptr<std::ofstream> output;
+
+    std::string journal_path;
+    std::unique_ptr<SweepJournal> journal;
+    int n_resumed = 0;
+
+    std::unique_ptr<ResultCache> cache;
+    std::atomic<int> n_cache_hits{0};
+
+    std::mutex numa_mutex;
+    NumaPageCount numa_report;
+
+    std::unique_ptr<ThreadScheduler> scheduler;
+};
+
+#endif //NC_SWEEP_H
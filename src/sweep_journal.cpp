@@ -0,0 +1,115 @@
+#include "sweep_journal.h"
+#include "code_version.h"
+#include "result_text.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char *journal_header = "nc sweep journal 1";
+
+
+// the line of a job, without the newline
+static string job_line(int parameter, int seed, double break_proportion, const VectorXi &density) {
+    ostringstream line;
+    line << "job " << parameter << " " << seed << " ";
+    write_result(line, break_proportion, density);
+    const string body = line.str();
+    return body + " " + hex_string(fnv1a(body));
+}
+
+
+// a job from its line, false if the line is not complete
+static bool parse_job_line(const string &line, JournalEntry &entry) {
+    const size_t last = line.rfind(' ');
+    if (last == string::npos || line.compare(0, 4, "job ") != 0) {
+        return false;
+    }
+    const string body = line.substr(0, last);
+    if (line.substr(last + 1) != hex_string(fnv1a(body))) {
+        return false;
+    }
+
+    istringstream in(body.substr(4));
+    return in >> entry.parameter >> entry.seed && read_result(in, entry.break_proportion, entry.density);
+}
+
+
+SweepJournal::SweepJournal(const string &path, const string &identity) : file(path), stale(false), fd(-1) {
+
+    const string first_line = string(journal_header) + " " + identity;
+
+    {
+        ifstream in(path);
+        string line;
+        if (getline(in, line)) {
+            if (line == first_line) {
+                set<pair<int, int>> seen;
+                JournalEntry entry;
+                while (getline(in, line)) {
+                    if (parse_job_line(line, entry) && seen.insert(make_pair(entry.parameter, entry.seed)).second) {
+                        previous.push_back(entry);
+                    }
+                }
+            } else {
+                stale = true;
+            }
+        }
+    }
+
+    if (stale && rename(path.c_str(), (path + ".stale").c_str()) != 0) {
+        throw runtime_error("cannot move the stale sweep journal " + path + " aside: " + strerror(errno));
+    }
+
+    // the valid lines only, so that appending starts on a line of its own
+    const string temporary = path + ".tmp";
+    {
+        ofstream out(temporary);
+        out << first_line << "\n";
+        for (const JournalEntry &e : previous) {
+            out << job_line(e.parameter, e.seed, e.break_proportion, e.density) << "\n";
+        }
+        out.flush();
+        if (!out) {
+            throw runtime_error("cannot write the sweep journal " + temporary);
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        throw runtime_error("cannot write the sweep journal " + path + ": " + strerror(errno));
+    }
+
+    fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        throw runtime_error("cannot write the sweep journal " + path + ": " + strerror(errno));
+    }
+}
+
+
+SweepJournal::~SweepJournal() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+void SweepJournal::append(int parameter, int seed, double break_proportion, const VectorXi &density) {
+    const string line = job_line(parameter, seed, break_proportion, density) + "\n";
+
+    lock_guard<mutex> lock(append_mutex);
+    if (write(fd, line.data(), line.size()) != ssize_t(line.size()) || fdatasync(fd) != 0) {
+        throw runtime_error("cannot write the sweep journal " + file + ": " + strerror(errno));
+    }
+}
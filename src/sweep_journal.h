@@ -0,0 +1,64 @@
+/*
+ * Journal of the finished jobs of a sweep, so that an interrupted sweep run again only runs the jobs that are missing.
+ *
+ * The file starts with a line identifying what the results belong to, the parameter sets, the number of seeds and the
+ * code version (src/code_version.h), and then has one line per finished job:
+ *
+ *     job <parameter> <seed> <break proportion> <number of parts> <cells in each part ...> <checksum>
+ *
+ * A line is appended with one write and synced before the job counts as done, and the checksum over the rest of the
+ * line drops a line cut short by a crash. The break proportion is written as src/result_text.h does, nan if no follower
+ * entered. Opening a journal keeps the jobs only if its identity is the same, otherwise
+ * it is moved aside to <path>.stale and a new one is started, so results of another grid or another build of the model
+ * are never reused. Either way the file is rewritten with just the valid lines.
+ */
+
+#ifndef NC_SWEEP_JOURNAL_H
+#define NC_SWEEP_JOURNAL_H
+
+#include <Eigen/Core>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+struct JournalEntry {
+    int parameter;
+    int seed;
+    double break_proportion;
+    Eigen::VectorXi density;
+};
+
+
+class SweepJournal {
+public:
+
+    // opens or starts the journal at path, throws std::runtime_error if it cannot be written
+    SweepJournal(const std::string &path, const std::string &identity);
+
+    ~SweepJournal();
+
+    SweepJournal(const SweepJournal &) = delete;
+
+    SweepJournal &operator=(const SweepJournal &) = delete;
+
+    // the jobs finished by earlier runs with the same identity, each once
+    const std::vector<JournalEntry> &entries() const { return previous; }
+
+    // whether a journal of another identity was moved aside
+    bool discarded_stale() const { return stale; }
+
+    // records a finished job, durably, may be called from any thread
+    void append(int parameter, int seed, double break_proportion, const Eigen::VectorXi &density);
+
+private:
+
+    std::string file;
+    std::vector<JournalEntry> previous;
+    bool stale;
+    int fd;
+    std::mutex append_mutex;
+};
+
+#endif //NC_SWEEP_JOURNAL_H
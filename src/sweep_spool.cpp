@@ -0,0 +1,415 @@
+#include "sweep_spool.h"
+#include "result_text.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char *manifest_header = "nc sweep spool 2";
+
+
+static void make_directory(const string &path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw runtime_error("cannot create " + path + ": " + strerror(errno));
+    }
+}
+
+
+// the entries of a directory, without the hidden ones, sorted
+static vector<string> list_directory(const string &path) {
+    vector<string> names;
+    DIR *d = opendir(path.c_str());
+    if (!d) {
+        throw runtime_error("cannot read " + path + ": " + strerror(errno));
+    }
+    while (struct dirent *entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+
+static bool process_alive(pid_t pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+
+// parameter and seed from a file name containing p<parameter>_s<seed>
+static bool parse_job(const string &name, SweepJob &job) {
+    const size_t p = name.find("_p") != string::npos ? name.find("_p") + 1 : 0;
+    return sscanf(name.c_str() + p, "p%d_s%d", &job.parameter, &job.seed) == 2;
+}
+
+
+// whether name is a finished job of the sweep, read into job, pro_break and density, false if it is not or the file is
+// not a complete result of that job
+static bool parse_done(const string &directory, const string &name, const vector<SimulationConfig> &sets, int n_seeds,
+                       SweepJob &job, double &pro_break, vector<int> &density) {
+    if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".csv") != 0) {
+        return false;
+    }
+
+    ifstream in(directory + "/done/" + name);
+    string line;
+    getline(in, line);
+    replace(line.begin(), line.end(), ',', ' ');
+
+    istringstream fields(line);
+    if (!(fields >> job.parameter >> job.seed) || !read_result_number(fields, pro_break) || job.parameter < 0 ||
+        job.parameter >= int(sets.size()) || job.seed < 0 || job.seed >= n_seeds) {
+        return false;
+    }
+    density.clear();
+    int cells;
+    while (fields >> cells) {
+        density.push_back(cells);
+    }
+    return fields.eof() && int(density.size()) == sets[job.parameter].density_bins();
+}
+
+
+SweepSpool SweepSpool::create(const string &directory, const Sweep &sweep) {
+    if (exists(directory)) {
+        throw runtime_error(directory + " holds a sweep spool already");
+    }
+
+    make_directory(directory);
+    for (const char *sub : {"/queue", "/claimed", "/done", "/failed"}) {
+        make_directory(directory + sub);
+    }
+
+    const vector<SweepJob> jobs = sweep.jobs();
+    for (size_t rank = 0; rank < jobs.size(); ++rank) {
+        char name[64];
+        snprintf(name, sizeof(name), "%08d_p%d_s%d", int(rank), jobs[rank].parameter, jobs[rank].seed);
+        ofstream(directory + "/queue/" + name);
+    }
+
+    // the manifest last, a spool without one is not complete
+    const string manifest = directory + "/manifest";
+    {
+        ofstream out(manifest + ".tmp");
+        out.precision(numeric_limits<double>::max_digits10);
+        out << manifest_header << "\n";
+        out << "seeds " << sweep.seeds() << "\n";
+        out << "sets " << sweep.parameter_sets().size() << "\n";
+        for (const SimulationConfig &config : sweep.parameter_sets()) {
+            for (const string &name : SimulationConfig::parameter_names()) {
+                out << name << " " << config.parameter(name) << "\n";
+            }
+            out << "output_prefix " << config.output_prefix << "\n";
+            out << "growth_cache " << config.growth_cache << "\n";
+            out << "chemo_format " << config.chemo_format << "\n";
+            out << "telemetry " << config.telemetry << "\n";
+            out << "live_view " << config.live_view << "\n";
+        }
+        if (!out) {
+            throw runtime_error("cannot write " + manifest);
+        }
+    }
+    rename((manifest + ".tmp").c_str(), manifest.c_str());
+
+    return SweepSpool(directory);
+}
+
+
+bool SweepSpool::exists(const string &directory) {
+    struct stat info;
+    return stat((directory + "/manifest").c_str(), &info) == 0;
+}
+
+
+SweepSpool::SweepSpool(const string &directory) : dir(directory), n_seeds(0) {
+    ifstream in(dir + "/manifest");
+    string line;
+    if (!getline(in, line) || line != manifest_header) {
+        throw runtime_error(dir + " does not hold a sweep spool");
+    }
+
+    string key;
+    size_t n_sets = 0;
+    in >> key >> n_seeds >> key >> n_sets;
+
+    sets.resize(n_sets);
+    for (SimulationConfig &config : sets) {
+        // parameters the manifest does not have keep their defaults
+        double value;
+        while (in >> key && key != "output_prefix") {
+            in >> value;
+            config.set_parameter(key, value);
+        }
+        in.ignore(1);
+        getline(in, config.output_prefix);
+
+        // then the other text settings, also defaults if missing
+        for (;;) {
+            const streampos before = in.tellg();
+            string *setting = nullptr;
+            if (in >> key) {
+                setting = key == "growth_cache" ? &config.growth_cache : key == "chemo_format" ? &config.chemo_format :
+                          key == "telemetry" ? &config.telemetry : key == "live_view" ? &config.live_view : nullptr;
+            }
+            if (!setting) {
+                in.clear();
+                in.seekg(before);
+                break;
+            }
+            in.ignore(1);
+            getline(in, *setting);
+        }
+    }
+
+    if (!in) {
+        throw runtime_error("the manifest of " + dir + " is incomplete");
+    }
+}
+
+
+bool SweepSpool::claim(SweepJob &job) {
+    for (const string &name : list_directory(dir + "/queue")) {
+        // a name that is not a job of this sweep would never be completed once claimed, it goes to failed
+        if (!parse_job(name, job) || job.parameter < 0 || job.parameter >= int(sets.size()) || job.seed < 0 ||
+            job.seed >= n_seeds) {
+            rename((dir + "/queue/" + name).c_str(), (dir + "/failed/" + name).c_str());
+            continue;
+        }
+        const string claimed = dir + "/claimed/" + name + "." + to_string(getpid());
+        if (rename((dir + "/queue/" + name).c_str(), claimed.c_str()) == 0) {
+            job.expected_cost = Sweep::expected_cost(sets[job.parameter]);
+            return true;
+        }
+        // otherwise another worker was faster
+    }
+    return false;
+}
+
+
+void SweepSpool::complete(const SweepJob &job, const VectorXi &density, double pro_break) {
+    const string name = "p" + to_string(job.parameter) + "_s" + to_string(job.seed);
+    const string path = dir + "/done/" + name + ".csv";
+
+    {
+        ofstream out(path + ".tmp");
+        out << job.parameter << ", " << job.seed << ", ";
+        write_result_number(out, pro_break);
+        for (int i = 0; i < density.size(); ++i) {
+            out << ", " << density(i);
+        }
+        out << "\n";
+        if (!out) {
+            throw runtime_error("cannot write " + path);
+        }
+    }
+    rename((path + ".tmp").c_str(), path.c_str());
+
+    const string suffix = "_" + name + "." + to_string(getpid());
+    for (const string &claimed : list_directory(dir + "/claimed")) {
+        if (claimed.size() > suffix.size() &&
+            claimed.compare(claimed.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            remove((dir + "/claimed/" + claimed).c_str());
+        }
+    }
+}
+
+
+int SweepSpool::requeue_abandoned() {
+    int requeued = 0;
+    for (const string &claimed : list_directory(dir + "/claimed")) {
+        const size_t dot = claimed.rfind('.');
+        if (dot == string::npos || process_alive(pid_t(atol(claimed.c_str() + dot + 1)))) {
+            continue;
+        }
+
+        // the claim file counts how often the job was abandoned
+        const string path = dir + "/claimed/" + claimed;
+        int attempts = 0;
+        ifstream(path) >> attempts;
+        attempts += 1;
+        ofstream(path) << attempts;
+
+        const string name = claimed.substr(0, dot);
+        const string target = dir + (attempts >= max_attempts ? "/failed/" : "/queue/") + name;
+        if (rename(path.c_str(), target.c_str()) == 0) {
+            requeued += 1;
+        }
+    }
+    return requeued;
+}
+
+
+int SweepSpool::queued() const {
+    return int(list_directory(dir + "/queue").size());
+}
+
+
+int SweepSpool::claimed() const {
+    return int(list_directory(dir + "/claimed").size());
+}
+
+
+int SweepSpool::failed() const {
+    return int(list_directory(dir + "/failed").size());
+}
+
+
+int SweepSpool::done() const {
+    int n = 0;
+    for (const string &name : list_directory(dir + "/done")) {
+        n += name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0;
+    }
+    return n;
+}
+
+
+int SweepSpool::malformed() const {
+    int n = 0;
+    SweepJob job;
+    double pro_break;
+    vector<int> density;
+    for (const string &name : list_directory(dir + "/done")) {
+        n += name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0 &&
+             !parse_done(dir, name, sets, n_seeds, job, pro_break, density);
+    }
+    return n;
+}
+
+
+int SweepSpool::work(int max_jobs) {
+    int ran = 0;
+    SweepJob job;
+    while ((max_jobs <= 0 || ran < max_jobs) && claim(job)) {
+
+        SimulationConfig config = sets[job.parameter];
+
+        // keep the snapshots of different jobs apart, as Sweep does
+        if (config.save_freq > 0 && sets.size() * n_seeds > 1) {
+            config.output_prefix += "p" + to_string(job.parameter) + "_s" + to_string(job.seed) + "_";
+        }
+
+        // a .prom file and a live view segment of this worker, the others have theirs (src/telemetry.h)
+        config.telemetry = Telemetry::process_path(config.telemetry, "w" + to_string(getpid()));
+        if (!config.live_view.empty()) {
+            config.live_view += "_w" + to_string(getpid());
+        }
+
+        Simulation simulation(config, job.seed);
+        simulation.set_telemetry_job("p" + to_string(job.parameter) + "_s" + to_string(job.seed));
+        simulation.run();
+
+        complete(job, simulation.density_profile(), simulation.break_proportion());
+        ran += 1;
+    }
+    return ran;
+}
+
+
+vector<EnsembleStats> SweepSpool::merge(const EnsembleStatsOptions &options) const {
+    vector<EnsembleStats> stats(sets.size(), EnsembleStats(options));
+
+    SweepJob job;
+    double pro_break;
+    vector<int> density;
+    for (const string &name : list_directory(dir + "/done")) {
+        // files that are not complete results of the sweep are left out, malformed() counts them
+        if (parse_done(dir, name, sets, n_seeds, job, pro_break, density)) {
+            stats[job.parameter].add_result(Map<const VectorXi>(density.data(), density.size()), pro_break);
+        }
+    }
+
+    return stats;
+}
+
+
+void SweepSpool::write_results(const string &path) const {
+    ofstream out(path);
+    if (!out) {
+        throw runtime_error("cannot write sweep results to " + path);
+    }
+    out << "parameter, seed, break proportion, density" << endl;
+    SweepJob job;
+    double pro_break;
+    vector<int> density;
+    for (const string &name : list_directory(dir + "/done")) {
+        if (parse_done(dir, name, sets, n_seeds, job, pro_break, density)) {
+            out << ifstream(dir + "/done/" + name).rdbuf();
+        }
+    }
+}
+
+
+int launch_workers(const string &directory, int processes, int jobs_per_process) {
+    SweepSpool spool(directory);
+    spool.requeue_abandoned();
+
+    set<pid_t> running;
+    int failures = 0;
+
+    auto spawn = [&]() {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            int code = 0;
+            try {
+                SweepSpool(directory).work(jobs_per_process);
+            } catch (const exception &e) {
+                fprintf(stderr, "sweep worker %d: %s\n", int(getpid()), e.what());
+                code = 1;
+            }
+            _exit(code);
+        }
+        if (pid < 0) {
+            throw runtime_error(string("cannot start a sweep worker: ") + strerror(errno));
+        }
+        running.insert(pid);
+    };
+
+    processes = max(1, processes);
+    while (int(running.size()) < processes && int(running.size()) < spool.queued()) {
+        spawn();
+    }
+
+    while (!running.empty()) {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (running.erase(pid) == 0) {
+            continue; // not one of ours
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures += 1;
+        }
+
+        // the claims of a crashed worker go back into the queue, and jobs left get a fresh worker
+        spool.requeue_abandoned();
+        while (int(running.size()) < processes && int(running.size()) < spool.queued()) {
+            spawn();
+        }
+    }
+
+    return failures;
+}
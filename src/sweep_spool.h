@@ -0,0 +1,96 @@
+/*
+ * A sweep split over worker processes through a spool directory on the local file system.
+ *
+ * create() writes the parameter sets to <directory>/manifest and one empty file per job to <directory>/queue, named
+ * <rank>_p<parameter>_s<seed>, rank 0 the longest expected job. A worker claims a job by renaming its file into
+ * <directory>/claimed with its process id appended. rename() is atomic, so of several workers only one succeeds and the
+ * others move on to the next file. A finished job is written to <directory>/done/p<parameter>_s<seed>.csv, as the line
+ * of SweepResults.csv, through a temporary file and a rename, and its claim is removed. Jobs claimed by a process that
+ * no longer exists, e.g. one that crashed, are put back into the queue by requeue_abandoned(), or into
+ * <directory>/failed once they were abandoned max_attempts times. A queue entry whose name is not a job of the sweep is
+ * moved to <directory>/failed instead of being claimed.
+ *
+ * Any number of workers may be started by hand on the machine (main --worker <directory>) or by launch_workers(),
+ * which also restarts workers after a number of jobs so that none lives long enough to fragment its heap. merge()
+ * combines the finished jobs into the statistics of every parameter set, at any time. Chemoattractant snapshots are
+ * not collected by workers. Each worker reports its telemetry to a .prom file of its own, with _w<process id> inserted
+ * (Telemetry::process_path), and publishes its live view to the segment named with _w<process id> appended.
+ */
+
+#ifndef NC_SWEEP_SPOOL_H
+#define NC_SWEEP_SPOOL_H
+
+#include "ensemble_stats.h"
+#include "simulation.h"
+#include "sweep.h"
+
+#include <Eigen/Core>
+
+#include <string>
+#include <vector>
+
+
+class SweepSpool {
+public:
+
+    static const int max_attempts = 3;
+
+    // lays out the spool of a sweep in directory, which is created if needed and must not hold a spool already
+    static SweepSpool create(const std::string &directory, const Sweep &sweep);
+
+    // whether directory holds a spool
+    static bool exists(const std::string &directory);
+
+    // opens the spool in directory, throws std::runtime_error if there is none
+    explicit SweepSpool(const std::string &directory);
+
+    const std::string &directory() const { return dir; }
+
+    const std::vector<SimulationConfig> &parameter_sets() const { return sets; }
+
+    int seeds() const { return n_seeds; }
+
+    // takes the next job from the queue for this process, false if the queue is empty
+    bool claim(SweepJob &job);
+
+    // stores the result of a claimed job and gives up the claim
+    void complete(const SweepJob &job, const Eigen::VectorXi &density, double pro_break);
+
+    // puts the jobs claimed by processes that are gone back into the queue, returns how many
+    int requeue_abandoned();
+
+    int queued() const;
+
+    int claimed() const;
+
+    int done() const;
+
+    // finished jobs whose file is not a complete result of the sweep, left out of merge()
+    int malformed() const;
+
+    // jobs abandoned max_attempts times and queue entries that are not jobs of the sweep
+    int failed() const;
+
+    // claims and runs jobs until the queue is empty or max_jobs ran (0 for no limit), returns how many ran
+    int work(int max_jobs = 0);
+
+    // statistics of the finished jobs of every parameter set, a NaN break proportion (no follower entered) included
+    std::vector<EnsembleStats> merge(const EnsembleStatsOptions &options = EnsembleStatsOptions()) const;
+
+    // the lines of all finished jobs in one file, in the format of Sweep::run's results file, as merge() without the
+    // malformed ones
+    void write_results(const std::string &path) const;
+
+private:
+
+    std::string dir;
+    std::vector<SimulationConfig> sets;
+    int n_seeds;
+};
+
+
+// runs the jobs of a spool in processes worker processes, each exiting after jobs_per_process jobs (0 for no limit)
+// and replaced while jobs are left, returns the number of workers that did not exit cleanly
+int launch_workers(const std::string &directory, int processes, int jobs_per_process = 0);
+
+#endif //NC_SWEEP_SPOOL_H
@@ -0,0 +1,248 @@
+#include "telemetry.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+
+const char *phase_name(int phase) {
+    static const char *names[n_phases] = {"insert", "growth", "chemo", "cells", "output"};
+    return names[phase];
+}
+
+
+long resident_memory() {
+    ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+
+shared_ptr<Telemetry> Telemetry::open(const string &path) {
+    static std::mutex registry_mutex;
+    static std::map<string, weak_ptr<Telemetry>> registry;
+
+    lock_guard<std::mutex> lock(registry_mutex);
+    shared_ptr<Telemetry> telemetry = registry[path].lock();
+    if (!telemetry) {
+        telemetry.reset(new Telemetry(path));
+        registry[path] = telemetry;
+    }
+    return telemetry;
+}
+
+
+string Telemetry::process_path(const string &path, const string &process) {
+    if (path.size() < 5 || path.compare(path.size() - 5, 5, ".prom") != 0) {
+        return path;
+    }
+    return path.substr(0, path.size() - 5) + "_" + process + ".prom";
+}
+
+
+Telemetry::Telemetry(const string &path)
+        : file(path), prometheus(path.size() >= 5 && path.compare(path.size() - 5, 5, ".prom") == 0) {}
+
+
+void Telemetry::report(const TelemetrySample &sample) {
+    lock_guard<std::mutex> lock(mutex);
+    const auto previous = jobs.find(sample.job);
+    const bool was_finished = previous != jobs.end() && previous->second.finished;
+    n_finished += int(sample.finished) - int(was_finished);
+    jobs[sample.job] = sample;
+
+    // the series of the jobs that finished longest ago go into the count of finished jobs
+    if (sample.finished && !was_finished && n_finished > max_finished_jobs) {
+        auto oldest = jobs.end();
+        for (auto job = jobs.begin(); job != jobs.end(); ++job) {
+            if (job->second.finished && (oldest == jobs.end() || job->second.timestamp < oldest->second.timestamp)) {
+                oldest = job;
+            }
+        }
+        jobs.erase(oldest);
+        n_finished--;
+        n_rolled_up++;
+    }
+
+    // monitoring must not end a simulation, e.g. on a full disk: the failure is counted and the next report tries again
+    try {
+        if (prometheus) {
+            write_prometheus();
+        } else {
+            append_json(sample);
+        }
+    } catch (const runtime_error &e) {
+        n_write_failures++;
+        error = e.what();
+    }
+}
+
+
+int Telemetry::write_failures() const {
+    lock_guard<std::mutex> lock(mutex);
+    return n_write_failures;
+}
+
+
+string Telemetry::last_error() const {
+    lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+
+static double phase_share(const TelemetrySample &sample, int phase) {
+    double total = 0;
+    for (double seconds : sample.phase_seconds) {
+        total += seconds;
+    }
+    return total > 0 ? sample.phase_seconds[phase] / total : 0;
+}
+
+
+// job names are ours, but keep the quoting valid
+static string quoted(const string &s) {
+    string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            q += '\\';
+        }
+        q += c;
+    }
+    return q + "\"";
+}
+
+
+void Telemetry::append_json(const TelemetrySample &sample) const {
+    ostringstream line;
+    line.precision(10);
+    line << "{\"job\": " << quoted(sample.job) << ", \"seed\": " << sample.seed << ", \"t\": " << sample.t
+         << ", \"final_time\": " << sample.final_time << ", \"step\": " << sample.step << ", \"steps\": "
+         << sample.steps << ", \"wall_seconds\": " << sample.wall_seconds << ", \"steps_per_second\": "
+         << sample.steps_per_second << ", \"eta_seconds\": " << sample.eta_seconds << ", \"cells\": " << sample.cells
+         << ", \"inserted\": " << sample.inserted << ", \"detached\": " << sample.detached << ", \"phase_share\": {";
+    for (int phase = 0; phase < n_phases; ++phase) {
+        line << (phase ? ", " : "") << quoted(phase_name(phase)) << ": " << phase_share(sample, phase);
+    }
+    line << "}, \"rss_bytes\": " << sample.rss_bytes << ", \"finished\": " << (sample.finished ? "true" : "false")
+         << ", \"timestamp\": " << sample.timestamp << "}\n";
+
+    ofstream out(file, ios::app);
+    out << line.str();
+    out.flush();
+    if (!out) {
+        throw runtime_error("cannot write the telemetry " + file);
+    }
+}
+
+
+void Telemetry::write_prometheus() const {
+    ostringstream out;
+    out.precision(10);
+
+    struct metric {
+        const char *name;
+        const char *help;
+        double (*value)(const TelemetrySample &);
+    };
+    static const metric metrics[] = {
+            {"nc_simulated_time", "Simulated time t.", [](const TelemetrySample &s) { return s.t; }},
+            {"nc_progress_ratio", "Timesteps done over timesteps until final_time.",
+             [](const TelemetrySample &s) { return s.steps > 0 ? double(s.step) / s.steps : 0.0; }},
+            {"nc_wall_seconds", "Wall time since the simulation started.",
+             [](const TelemetrySample &s) { return s.wall_seconds; }},
+            {"nc_steps_per_second", "Timesteps per second since the previous report.",
+             [](const TelemetrySample &s) { return s.steps_per_second; }},
+            {"nc_eta_seconds", "Wall time until final_time at that rate.",
+             [](const TelemetrySample &s) { return s.eta_seconds; }},
+            {"nc_cells", "Cells in the domain.", [](const TelemetrySample &s) { return double(s.cells); }},
+            {"nc_cells_inserted", "Cells that entered the domain.",
+             [](const TelemetrySample &s) { return double(s.inserted); }},
+            {"nc_cells_detached", "Followers not in a chain.",
+             [](const TelemetrySample &s) { return double(s.detached); }},
+            {"nc_finished", "1 once the simulation reached final_time.",
+             [](const TelemetrySample &s) { return s.finished ? 1.0 : 0.0; }},
+            {"nc_last_report_timestamp_seconds", "Time of the latest report, seconds since the epoch.",
+             [](const TelemetrySample &s) { return s.timestamp; }},
+    };
+
+    for (const metric &m : metrics) {
+        out << "# HELP " << m.name << " " << m.help << "\n# TYPE " << m.name << " gauge\n";
+        for (const auto &job : jobs) {
+            out << m.name << "{job=" << quoted(job.first) << ",seed=\"" << job.second.seed << "\"} "
+                << m.value(job.second) << "\n";
+        }
+    }
+
+    out << "# HELP nc_phase_share Share of the wall time of a timestep in each phase.\n"
+        << "# TYPE nc_phase_share gauge\n";
+    for (const auto &job : jobs) {
+        for (int phase = 0; phase < n_phases; ++phase) {
+            out << "nc_phase_share{job=" << quoted(job.first) << ",seed=\"" << job.second.seed << "\",phase="
+                << quoted(phase_name(phase)) << "} " << phase_share(job.second, phase) << "\n";
+        }
+    }
+
+    // over the jobs of the process
+    int running = 0, finished = n_rolled_up;
+    double rate = 0;
+    long rss = 0;
+    for (const auto &job : jobs) {
+        if (job.second.finished) {
+            finished++;
+        } else {
+            running++;
+            rate += job.second.steps_per_second;
+        }
+        rss = max(rss, job.second.rss_bytes);
+    }
+    out << "# HELP nc_jobs Simulations reporting here.\n# TYPE nc_jobs gauge\n"
+        << "nc_jobs{state=\"running\"} " << running << "\nnc_jobs{state=\"finished\"} " << finished << "\n"
+        << "# HELP nc_steps_per_second_total Timesteps per second of the running simulations together.\n"
+        << "# TYPE nc_steps_per_second_total gauge\nnc_steps_per_second_total " << rate << "\n"
+        << "# HELP nc_resident_memory_bytes Resident memory of the process.\n"
+        << "# TYPE nc_resident_memory_bytes gauge\nnc_resident_memory_bytes " << rss << "\n"
+        << "# HELP nc_telemetry_write_failures_total Reports that could not be written here.\n"
+        << "# TYPE nc_telemetry_write_failures_total counter\nnc_telemetry_write_failures_total " << n_write_failures
+        << "\n";
+
+    // the collector must never read a partial file, and the temporary name is unique, so that processes reporting to the
+    // same path by mistake never write into each other's
+    string temporary = file + "." + to_string(getpid()) + ".XXXXXX";
+    const int fd = mkstemp(&temporary[0]);
+    if (fd < 0) {
+        throw runtime_error("cannot write the telemetry " + temporary + ": " + strerror(errno));
+    }
+    const string text = out.str();
+    size_t written = 0;
+    while (written < text.size()) {
+        const ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += size_t(n);
+    }
+    const bool ok = written == text.size() && fchmod(fd, 0644) == 0; // mkstemp gives 0600, the collector reads it
+    close(fd);
+    if (!ok || rename(temporary.c_str(), file.c_str()) != 0) {
+        const string error = strerror(errno);
+        unlink(temporary.c_str());
+        throw runtime_error("cannot write the telemetry " + file + ": " + error);
+    }
+}
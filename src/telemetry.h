@@ -0,0 +1,109 @@
+/*
+ * Progress of running simulations for monitoring, e.g. by a node exporter.
+ *
+ * A simulation with SimulationConfig::telemetry set reports a TelemetrySample every telemetry_interval seconds of wall
+ * time and when it finishes. Simulations of a process that report to the same path share one Telemetry, which keeps
+ * the latest sample of every job:
+ *  - a path ending in .prom is rewritten with every report in the Prometheus text format, one series per job and
+ *    metric plus totals over the jobs, through a temporary file and a rename, for the textfile collector,
+ *  - any other path gets one JSON object per report appended (JSON lines).
+ * A .prom file holds the jobs of one process only, so its path must be one of the process: processes of a run that
+ * report to the same path, the branches of a ForkedEnsemble and the workers of a SweepSpool, report to
+ * process_path() of it instead, e.g. nc_b5.prom, which the collector reads as any other file. JSON lines are appended
+ * a whole line at a time and may be shared.
+ * A job whose nc_last_report_timestamp_seconds stops moving while it is not finished has stalled. Of the finished jobs
+ * the latest max_finished_jobs keep their series, so that the file of a long sweep stays small. A report that cannot be
+ * written, e.g. on a full disk, is counted in nc_telemetry_write_failures_total and write_failures(), and never stops
+ * the simulation.
+ */
+
+#ifndef NC_TELEMETRY_H
+#define NC_TELEMETRY_H
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+// the parts of a timestep whose time is measured
+enum TelemetryPhase {
+    phase_insert, // cells entering the domain
+    phase_growth, // domain growth
+    phase_chemo, // chemoattractant
+    phase_cells, // cell movement
+    phase_output, // saves, checkpoints and the live view
+    n_phases
+};
+
+const char *phase_name(int phase);
+
+
+struct TelemetrySample {
+    std::string job;
+    int seed = 0;
+    double t = 0; // simulated time
+    double final_time = 0;
+    int step = 0;
+    int steps = 0; // until final_time
+    double wall_seconds = 0; // since the simulation started
+    double steps_per_second = 0; // since the previous report
+    double eta_seconds = 0; // at that rate
+    int cells = 0;
+    int inserted = 0; // cells that entered the domain
+    int detached = 0; // followers not in a chain
+    std::array<double, n_phases> phase_seconds{}; // wall time in each phase since the start
+    long rss_bytes = 0; // resident memory of the process
+    bool finished = false;
+    double timestamp = 0; // seconds since the epoch
+};
+
+
+class Telemetry {
+public:
+
+    // the telemetry writing to path, shared by the simulations of the process that report there
+    static std::shared_ptr<Telemetry> open(const std::string &path);
+
+    // the path the process named process reports to instead of path: _<process> inserted before .prom, JSON lines
+    // paths as they are
+    static std::string process_path(const std::string &path, const std::string &process);
+
+    // finished jobs that keep their series, older ones are only counted in nc_jobs{state="finished"}
+    static const int max_finished_jobs = 64;
+
+    // records the sample of its job and writes; a write that fails is counted and the simulation carries on
+    void report(const TelemetrySample &sample);
+
+    const std::string &path() const { return file; }
+
+    // reports that could not be written, and why the latest of them failed
+    int write_failures() const;
+
+    std::string last_error() const;
+
+private:
+
+    explicit Telemetry(const std::string &path);
+
+    void write_prometheus() const;
+
+    void append_json(const TelemetrySample &sample) const;
+
+    std::string file;
+    bool prometheus;
+
+    mutable std::mutex mutex;
+    std::map<std::string, TelemetrySample> jobs; // the latest sample of every job
+    int n_finished = 0; // of the jobs
+    int n_rolled_up = 0; // finished jobs taken out of jobs
+    int n_write_failures = 0;
+    std::string error;
+};
+
+
+// resident memory of the process in bytes, 0 if unknown
+long resident_memory();
+
+#endif //NC_TELEMETRY_H
@@ -0,0 +1,82 @@
+#include "thread_scheduler.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+ThreadScheduler::ThreadScheduler(int cores, int rows_per_thread)
+        : n_cores(max(1, cores)), rows_per_thread(max(1, rows_per_thread)) {
+}
+
+
+int ThreadScheduler::concurrency(int jobs) const {
+    return max(1, min(jobs, n_cores));
+}
+
+
+int ThreadScheduler::max_threads(const SimulationConfig &config) const {
+    return max(1, min(n_cores, config.length_x() / rows_per_thread));
+}
+
+
+int ThreadScheduler::enter(double remaining_work, int max_threads) {
+    lock_guard<std::mutex> lock(mutex);
+
+    // reuse the slot of a finished job
+    size_t s = 0;
+    while (s < slots.size() && slots[s].active) {
+        ++s;
+    }
+    if (s == slots.size()) {
+        slots.emplace_back();
+    }
+    slots[s] = job_slot{true, remaining_work, max(1, max_threads), 1};
+
+    rebalance();
+    return int(s);
+}
+
+
+int ThreadScheduler::update(int slot, double remaining_work) {
+    lock_guard<std::mutex> lock(mutex);
+    slots[slot].work = remaining_work;
+    rebalance();
+    return slots[slot].threads;
+}
+
+
+void ThreadScheduler::leave(int slot) {
+    lock_guard<std::mutex> lock(mutex);
+    slots[slot].active = false;
+    rebalance();
+}
+
+
+void ThreadScheduler::rebalance() {
+
+    // one thread for every running job
+    int spare = n_cores;
+    for (job_slot &slot : slots) {
+        if (slot.active) {
+            slot.threads = 1;
+            spare -= 1;
+        }
+    }
+
+    // and each spare core to the job with the most work left per thread
+    while (spare > 0) {
+        job_slot *neediest = nullptr;
+        for (job_slot &slot : slots) {
+            if (slot.active && slot.threads < slot.max_threads &&
+                (!neediest || slot.work / slot.threads > neediest->work / neediest->threads)) {
+                neediest = &slot;
+            }
+        }
+        if (!neediest) {
+            break;
+        }
+        neediest->threads += 1;
+        spare -= 1;
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Shares the cores of a sweep between the simulations running side by side and the threads inside each of them.
+ *
+ * While there are at least as many jobs left as cores, every core runs its own simulation on one thread, which is the
+ * cheapest way to use them. Once the sweep drains and fewer simulations are left than cores, the spare cores are handed
+ * to the running simulations, most to those with the most work left, so the tail of a sweep does not leave most cores
+ * idle. A simulation gets no more threads than its grid can use, max_threads() of its configuration.
+ *
+ * Running jobs enter() with their remaining work, report it again every so often with update(), which returns the
+ * number of threads they should use from then on, and leave() when they are done.
+ */
+
+#ifndef NC_THREAD_SCHEDULER_H
+#define NC_THREAD_SCHEDULER_H
+
+#include "simulation.h"
+
+#include <mutex>
+#include <vector>
+
+
+class ThreadScheduler {
+public:
+
+    // rows_per_thread is the smallest number of grid columns along x worth giving a thread of its own
+    explicit ThreadScheduler(int cores, int rows_per_thread = 32);
+
+    int cores() const { return n_cores; }
+
+    // how many simulations to run side by side for a number of jobs
+    int concurrency(int jobs) const;
+
+    // the most threads a simulation of this configuration can use
+    int max_threads(const SimulationConfig &config) const;
+
+    // a job starts, returns its slot
+    int enter(double remaining_work, int max_threads);
+
+    // the remaining work of a running job, returns the number of threads it should use now
+    int update(int slot, double remaining_work);
+
+    void leave(int slot);
+
+private:
+
+    struct job_slot {
+        bool active;
+        double work;
+        int max_threads;
+        int threads;
+    };
+
+    // called with the mutex held
+    void rebalance();
+
+    int n_cores;
+    int rows_per_thread;
+
+    std::mutex mutex;
+    std::vector<job_slot> slots;
+};
+
+#endif //NC_THREAD_SCHEDULER_H
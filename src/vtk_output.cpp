@@ -0,0 +1,110 @@
+#include "vtk_output.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+
+static const char *byte_order() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 1 ? "LittleEndian" : "BigEndian";
+}
+
+
+// one block of the appended data: its size in bytes, then the values
+template<typename T>
+static void write_block(ostream &out, const T *values, size_t n) {
+    const uint64_t bytes = n * sizeof(T);
+    out.write(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+    out.write(reinterpret_cast<const char *>(values), streamsize(bytes));
+}
+
+
+void write_vtr(const string &path, const VectorXd &x, const VectorXd &y, const MatrixXd &u, bool single_precision) {
+    const long nx = long(x.size());
+    const long ny = long(y.size());
+    if (u.rows() != nx || u.cols() != ny) {
+        throw invalid_argument("write_vtr: u is " + to_string(u.rows()) + " x " + to_string(u.cols()) +
+                               ", the coordinates " + to_string(nx) + " x " + to_string(ny));
+    }
+
+    const char *u_type = single_precision ? "Float32" : "Float64";
+    const uint64_t u_bytes = uint64_t(nx * ny) * (single_precision ? sizeof(float) : sizeof(double));
+
+    // offsets of the blocks in the appended data, each after its 8 byte size
+    const uint64_t u_offset = 0;
+    const uint64_t x_offset = u_offset + 8 + u_bytes;
+    const uint64_t y_offset = x_offset + 8 + uint64_t(nx) * sizeof(double);
+    const uint64_t z_offset = y_offset + 8 + uint64_t(ny) * sizeof(double);
+
+    ofstream out(path, ios::binary);
+    out << "<?xml version=\"1.0\"?>\n"
+        << "<VTKFile type=\"RectilinearGrid\" version=\"1.0\" byte_order=\"" << byte_order()
+        << "\" header_type=\"UInt64\">\n"
+        << "  <RectilinearGrid WholeExtent=\"0 " << nx - 1 << " 0 " << ny - 1 << " 0 0\">\n"
+        << "    <Piece Extent=\"0 " << nx - 1 << " 0 " << ny - 1 << " 0 0\">\n"
+        << "      <PointData Scalars=\"u\">\n"
+        << "        <DataArray type=\"" << u_type << "\" Name=\"u\" format=\"appended\" offset=\"" << u_offset
+        << "\"/>\n"
+        << "      </PointData>\n"
+        << "      <Coordinates>\n"
+        << "        <DataArray type=\"Float64\" Name=\"x\" format=\"appended\" offset=\"" << x_offset << "\"/>\n"
+        << "        <DataArray type=\"Float64\" Name=\"y\" format=\"appended\" offset=\"" << y_offset << "\"/>\n"
+        << "        <DataArray type=\"Float64\" Name=\"z\" format=\"appended\" offset=\"" << z_offset << "\"/>\n"
+        << "      </Coordinates>\n"
+        << "    </Piece>\n"
+        << "  </RectilinearGrid>\n"
+        << "  <AppendedData encoding=\"raw\">\n"
+        << "   _";
+
+    // VTK points run x fastest, as the columns of u do
+    if (single_precision) {
+        const vector<float> u_float(u.data(), u.data() + u.size());
+        write_block(out, u_float.data(), u_float.size());
+    } else {
+        write_block(out, u.data(), size_t(u.size()));
+    }
+    write_block(out, x.data(), size_t(nx));
+    write_block(out, y.data(), size_t(ny));
+    const double z = 0;
+    write_block(out, &z, 1);
+
+    out << "\n  </AppendedData>\n"
+        << "</VTKFile>\n";
+
+    if (!out) {
+        throw runtime_error("cannot write " + path);
+    }
+}
+
+
+void write_pvd(const string &path, const vector<pair<double, string>> &datasets) {
+    const string temporary = path + ".tmp";
+    {
+        ofstream out(temporary);
+        out.precision(numeric_limits<double>::max_digits10);
+        out << "<?xml version=\"1.0\"?>\n"
+            << "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"" << byte_order() << "\">\n"
+            << "  <Collection>\n";
+        for (const pair<double, string> &dataset : datasets) {
+            out << "    <DataSet timestep=\"" << dataset.first << "\" group=\"\" part=\"0\" file=\"" << dataset.second
+                << "\"/>\n";
+        }
+        out << "  </Collection>\n"
+            << "</VTKFile>\n";
+        if (!out) {
+            throw runtime_error("cannot write " + temporary);
+        }
+    }
+
+    // ParaView may be reading the index while the run goes on
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        throw runtime_error("cannot write " + path);
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ * VTK XML output that needs no VTK library, for ParaView.
+ *
+ * The chemoattractant grid only stretches along x, so a snapshot is a RectilinearGrid (.vtr): the x coordinates of the
+ * grid columns on the grown domain, the y coordinates and a single z = 0 are stored once, and u once per grid point,
+ * all as raw binary in the appended data section. A .pvd collection lists the snapshots with their times, so that
+ * ParaView opens the whole run as one time series.
+ */
+
+#ifndef NC_VTK_OUTPUT_H
+#define NC_VTK_OUTPUT_H
+
+#include <Eigen/Core>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// u(i, j) at (x(i), y(j)), u as Float32 if single_precision, throws std::runtime_error if the file cannot be written
+void write_vtr(const std::string &path, const Eigen::VectorXd &x, const Eigen::VectorXd &y, const Eigen::MatrixXd &u,
+               bool single_precision);
+
+// the collection of (time, file) data sets, file names relative to the .pvd, throws std::runtime_error on failure
+void write_pvd(const std::string &path, const std::vector<std::pair<double, std::string>> &datasets);
+
+#endif //NC_VTK_OUTPUT_H
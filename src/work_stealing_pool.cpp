@@ -0,0 +1,89 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <thread>
+
+
+static thread_local int worker_index = -1;
+
+
+WorkStealingPool::WorkStealingPool(int n_threads) : n_threads(std::max(1, n_threads)) {
+    for (int w = 0; w < this->n_threads; ++w) {
+        queues.emplace_back(new worker_queue);
+    }
+}
+
+
+int WorkStealingPool::current_worker() {
+    return worker_index;
+}
+
+
+void WorkStealingPool::run(std::vector<task_type> tasks) {
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        queues[i % n_threads]->tasks.push_back(std::move(tasks[i]));
+    }
+
+    error = nullptr;
+
+    std::vector<std::thread> threads;
+    for (int w = 1; w < n_threads; ++w) {
+        threads.emplace_back(&WorkStealingPool::work, this, w);
+    }
+    work(0); // the calling thread is worker 0
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+bool WorkStealingPool::pop(int w, task_type &task) {
+    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+    if (queues[w]->tasks.empty()) {
+        return false;
+    }
+    task = std::move(queues[w]->tasks.front());
+    queues[w]->tasks.pop_front();
+    return true;
+}
+
+
+bool WorkStealingPool::steal(int w, task_type &task) {
+    for (int k = 1; k < n_threads; ++k) {
+        worker_queue &victim = *queues[(w + k) % n_threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// no tasks are added during run(), so a worker that finds every deque empty is done
+void WorkStealingPool::work(int w) {
+    const int previous = worker_index;
+    worker_index = w;
+
+    task_type task;
+    while (pop(w, task) || steal(w, task)) {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    worker_index = previous;
+}
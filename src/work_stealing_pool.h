@@ -0,0 +1,56 @@
+/*
+ * Runs a batch of tasks on a fixed number of threads with work stealing.
+ *
+ * Tasks are dealt to the workers' deques in round robin, in the order given. A worker runs its own tasks from the
+ * front, and when it has none left it steals from the back of another worker's deque. Given tasks sorted longest
+ * first, every worker starts on the longest ones and idle workers pick up the shortest leftovers, which keeps the tail
+ * of a batch short.
+ */
+
+#ifndef NC_WORK_STEALING_POOL_H
+#define NC_WORK_STEALING_POOL_H
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+class WorkStealingPool {
+public:
+
+    typedef std::function<void()> task_type;
+
+    explicit WorkStealingPool(int n_threads);
+
+    int size() const { return n_threads; }
+
+    // runs all tasks and returns when they are done, rethrows the first exception a task threw
+    void run(std::vector<task_type> tasks);
+
+    // index of the worker running the calling task, -1 outside of run()
+    static int current_worker();
+
+private:
+
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    bool pop(int w, task_type &task);
+
+    bool steal(int w, task_type &task);
+
+    void work(int w);
+
+    int n_threads;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+#endif //NC_WORK_STEALING_POOL_H